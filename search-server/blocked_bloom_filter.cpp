@@ -0,0 +1,12 @@
+#include "blocked_bloom_filter.h"
+
+BlockedBloomFilter::BlockedBloomFilter(size_t capacity)
+{
+    size_t block_count = 1;
+    while (block_count * WORDS_PER_BLOCK < capacity)
+    {
+        block_count *= 2;
+    }
+    capacity_ = block_count * WORDS_PER_BLOCK;
+    blocks_.resize(block_count);
+}
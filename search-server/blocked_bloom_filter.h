@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "word_hash.h"
+
+// Блочный фильтр Блума: все биты слова лежат в одном блоке размером с кеш-линию,
+// по одному биту в каждом из восьми 64-битных слов блока. Ложных отрицательных ответов нет,
+// удалять слова нельзя - фильтр перестраивается целиком.
+class BlockedBloomFilter
+{
+public:
+    // capacity - сколько слов можно добавить, сохраняя долю ложных срабатываний порядка 0.1%
+    explicit BlockedBloomFilter(size_t capacity = 0);
+
+    inline void Add(std::string_view word)
+    {
+        const uint64_t hash = HashWord(word);
+        Block& block = blocks_[MixHash(hash, 0) & (blocks_.size() - 1)];
+        const uint64_t bits = MixHash(hash, 1);
+        for (size_t i = 0; i < BLOCK_WORDS; ++i)
+        {
+            block.words[i] |= uint64_t{1} << (bits >> (6 * i) & 63);
+        }
+    }
+
+    inline bool MayContain(std::string_view word) const
+    {
+        const uint64_t hash = HashWord(word);
+        const Block& block = blocks_[MixHash(hash, 0) & (blocks_.size() - 1)];
+        const uint64_t bits = MixHash(hash, 1);
+        bool contains = true;
+        for (size_t i = 0; i < BLOCK_WORDS; ++i)
+        {
+            contains &= (block.words[i] >> (bits >> (6 * i) & 63) & 1) != 0;
+        }
+        return contains;
+    }
+
+    inline size_t GetCapacity() const
+    {
+        return capacity_;
+    }
+
+    inline size_t GetMemoryBytes() const
+    {
+        return blocks_.capacity() * sizeof(Block);
+    }
+
+private:
+    static const size_t BLOCK_WORDS = 8;
+    static const size_t WORDS_PER_BLOCK = 32; // около 16 бит на слово
+
+    struct alignas(64) Block
+    {
+        uint64_t words[BLOCK_WORDS] = {};
+    };
+
+    size_t capacity_;
+    std::vector<Block> blocks_;
+};
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// Разбор числовых аргументов командной строки для search_service и load_generator;
+// только заголовок, чтобы генератор нагрузки не тянул за собой SearchServer.
+
+inline size_t ParseCount(const std::string& value, const std::string& name)
+{
+    const long long count = std::stoll(value);
+    if (count <= 0)
+    {
+        throw std::invalid_argument(name + " must be positive");
+    }
+    return static_cast<size_t>(count);
+}
+
+inline uint16_t ParsePort(const std::string& value, const std::string& name)
+{
+    const size_t port = ParseCount(value, name);
+    if (port > std::numeric_limits<uint16_t>::max())
+    {
+        throw std::invalid_argument(name + " must not exceed " + std::to_string(std::numeric_limits<uint16_t>::max()));
+    }
+    return static_cast<uint16_t>(port);
+}
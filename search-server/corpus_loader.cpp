@@ -0,0 +1,202 @@
+#include "corpus_loader.h"
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+using namespace std::literals;
+
+namespace
+{
+    const size_t MAX_QUEUED_BATCHES = 4;
+
+    std::string_view NextField(std::string_view& line)
+    {
+        const size_t tab = line.find('\t');
+        std::string_view field = line.substr(0, tab);
+        line.remove_prefix(tab == std::string_view::npos ? line.size() : tab + 1);
+        return field;
+    }
+
+    bool ParseInt(std::string_view text, int& value)
+    {
+        const char* end = text.data() + text.size();
+        const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+        return ec == std::errc() && ptr == end;
+    }
+
+    bool ParseStatus(std::string_view text, DocumentStatus& status)
+    {
+        static const std::pair<std::string_view, DocumentStatus> names[] = {
+            {"ACTUAL"sv, DocumentStatus::ACTUAL},
+            {"IRRELEVANT"sv, DocumentStatus::IRRELEVANT},
+            {"BANNED"sv, DocumentStatus::BANNED},
+            {"REMOVED"sv, DocumentStatus::REMOVED},
+        };
+        for (const auto& [name, value] : names)
+        {
+            if (text == name)
+            {
+                status = value;
+                return true;
+            }
+        }
+        int number = 0;
+        if (ParseInt(text, number) && number >= 0 && number <= static_cast<int>(DocumentStatus::REMOVED))
+        {
+            status = static_cast<DocumentStatus>(number);
+            return true;
+        }
+        return false;
+    }
+}
+
+ParsedDocument ParseCorpusLine(std::string_view line)
+{
+    ParsedDocument document;
+    const std::string_view id = NextField(line);
+    const std::string_view status = NextField(line);
+    std::string_view ratings = NextField(line);
+
+    if (!ParseInt(id, document.id) || document.id < 0)
+    {
+        throw std::invalid_argument("Invalid document id: "s + std::string(id));
+    }
+    if (!ParseStatus(status, document.status))
+    {
+        throw std::invalid_argument("Invalid document status: "s + std::string(status));
+    }
+    for (const std::string_view rating : SplitIntoWordsView(ratings))
+    {
+        int value = 0;
+        if (!ParseInt(rating, value))
+        {
+            throw std::invalid_argument("Invalid rating: "s + std::string(rating));
+        }
+        document.ratings.push_back(value);
+    }
+    if (document.ratings.empty()) // средний рейтинг пустого списка не определён
+    {
+        throw std::invalid_argument("Empty ratings"s);
+    }
+    document.text = line;
+    return document;
+}
+
+size_t LoadCorpus(SearchServer& search_server, int fd, size_t batch_size)
+{
+    std::mutex mutex;
+    std::condition_variable queue_changed;
+    std::deque<std::vector<ParsedDocument>> batches;
+    bool parsing_done = false;
+    bool indexing_stopped = false;
+    std::exception_ptr parse_error;
+
+    std::thread parser([&]
+    {
+        try
+        {
+            LineReader reader(fd);
+            std::vector<ParsedDocument> batch;
+            batch.reserve(batch_size);
+            size_t line_number = 0;
+            std::string_view line;
+
+            const auto push_batch = [&]
+            {
+                std::unique_lock lock(mutex);
+                queue_changed.wait(lock, [&]{ return batches.size() < MAX_QUEUED_BATCHES || indexing_stopped; });
+                if (!indexing_stopped)
+                {
+                    batches.push_back(std::move(batch));
+                    queue_changed.notify_all();
+                }
+                batch.clear();
+                batch.reserve(batch_size);
+                return !indexing_stopped;
+            };
+
+            while (reader.NextLine(line))
+            {
+                ++line_number;
+                if (line.empty())
+                {
+                    continue;
+                }
+                try
+                {
+                    batch.push_back(ParseCorpusLine(line));
+                }
+                catch (const std::invalid_argument& e)
+                {
+                    throw std::invalid_argument("Line "s + std::to_string(line_number) + ": "s + e.what());
+                }
+                if (batch.size() == batch_size && !push_batch())
+                {
+                    break;
+                }
+            }
+            if (!batch.empty())
+            {
+                push_batch();
+            }
+        }
+        catch (...)
+        {
+            parse_error = std::current_exception();
+        }
+        std::lock_guard lock(mutex);
+        parsing_done = true;
+        queue_changed.notify_all();
+    });
+
+    size_t added = 0;
+    try
+    {
+        while (true)
+        {
+            std::vector<ParsedDocument> batch;
+            {
+                std::unique_lock lock(mutex);
+                queue_changed.wait(lock, [&]{ return !batches.empty() || parsing_done; });
+                if (batches.empty())
+                {
+                    break;
+                }
+                batch = std::move(batches.front());
+                batches.pop_front();
+                queue_changed.notify_all();
+            }
+            for (const ParsedDocument& document : batch)
+            {
+                search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+                ++added;
+            }
+        }
+    }
+    catch (...)
+    {
+        {
+            std::lock_guard lock(mutex);
+            indexing_stopped = true;
+            queue_changed.notify_all();
+        }
+        parser.join();
+        throw;
+    }
+
+    parser.join();
+    if (parse_error)
+    {
+        std::rethrow_exception(parse_error);
+    }
+    return added;
+}
+
+size_t LoadCorpus(SearchServer& search_server, const std::string& path, size_t batch_size)
+{
+    FdGuard guard{OpenForReading(path)};
+    return LoadCorpus(search_server, guard.fd, batch_size);
+}
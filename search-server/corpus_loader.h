@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "line_reader.h"
+#include "search_server.h"
+
+// Формат корпуса: одна строка на документ, поля разделены табуляцией
+//   id <TAB> status <TAB> рейтинги через пробел <TAB> текст
+// status задаётся именем (ACTUAL, IRRELEVANT, BANNED, REMOVED) или номером.
+
+struct ParsedDocument
+{
+    int id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+ParsedDocument ParseCorpusLine(std::string_view line);
+
+// разбор идёт в отдельном потоке, документы передаются в AddDocument пачками
+size_t LoadCorpus(SearchServer& search_server, int fd, size_t batch_size = 1024);
+size_t LoadCorpus(SearchServer& search_server, const std::string& path, size_t batch_size = 1024);
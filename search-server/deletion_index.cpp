@@ -0,0 +1,168 @@
+#include "deletion_index.h"
+#include <algorithm>
+#include "memory_stats.h"
+
+namespace
+{
+    // удаляем символы только правее предыдущего удаления, чтобы не перебирать одно и то же;
+    // удалённый символ возвращается на место, так что строка не копируется
+    void CollectDeletions(std::string& word, size_t start, size_t depth, std::pmr::vector<size_t>& hashes)
+    {
+        hashes.push_back(std::hash<std::string_view>{}(word));
+        if (depth == 0)
+        {
+            return;
+        }
+        for (size_t i = start; i < word.size(); ++i)
+        {
+            const char removed = word[i];
+            word.erase(i, 1);
+            CollectDeletions(word, i, depth - 1, hashes);
+            word.insert(i, 1, removed);
+        }
+    }
+}
+
+size_t EditDistance(std::string_view lhs, std::string_view rhs, size_t limit)
+{
+    const size_t length_difference = lhs.size() > rhs.size() ? lhs.size() - rhs.size() : rhs.size() - lhs.size();
+    if (length_difference > limit)
+    {
+        return limit + 1;
+    }
+
+    // три последние строки таблицы: перестановке нужна позапрошлая
+    std::vector<size_t> before_previous(rhs.size() + 1, 0);
+    std::vector<size_t> previous(rhs.size() + 1, 0);
+    std::vector<size_t> current(rhs.size() + 1, 0);
+    for (size_t j = 0; j <= rhs.size(); ++j)
+    {
+        previous[j] = j;
+    }
+    for (size_t i = 1; i <= lhs.size(); ++i)
+    {
+        current[0] = i;
+        size_t row_minimum = current[0];
+        for (size_t j = 1; j <= rhs.size(); ++j)
+        {
+            const size_t substitution = previous[j - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1);
+            current[j] = std::min({previous[j] + 1, current[j - 1] + 1, substitution});
+            if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1])
+            {
+                current[j] = std::min(current[j], before_previous[j - 2] + 1);
+            }
+            row_minimum = std::min(row_minimum, current[j]);
+        }
+        if (row_minimum > limit)
+        {
+            return limit + 1;
+        }
+        std::swap(before_previous, previous);
+        std::swap(previous, current);
+    }
+    return std::min(previous[rhs.size()], limit + 1);
+}
+
+DeletionIndex::DeletionIndex(size_t max_distance, std::pmr::memory_resource* resource)
+    : max_distance_(max_distance)
+    , terms_(resource)
+    , free_terms_(resource)
+    , deletions_(resource)
+{
+
+}
+
+void DeletionIndex::AddTerm(std::string_view term)
+{
+    uint32_t term_id = 0;
+    if (free_terms_.empty())
+    {
+        term_id = static_cast<uint32_t>(terms_.size());
+        terms_.emplace_back(term);
+    }
+    else
+    {
+        term_id = free_terms_.back();
+        free_terms_.pop_back();
+        terms_[term_id] = term;
+    }
+
+    for (const size_t hash : GetDeletionHashes(term, std::pmr::get_default_resource()))
+    {
+        deletions_[hash].push_back(term_id);
+    }
+}
+
+void DeletionIndex::RemoveTerm(std::string_view term)
+{
+    // префикс слова - строка без удалений, поэтому номер слова лежит под его хешем
+    const auto self_it = deletions_.find(std::hash<std::string_view>{}(term.substr(0, DELETION_PREFIX_LENGTH)));
+    if (self_it == deletions_.end())
+    {
+        return;
+    }
+    const auto id_it = std::find_if(self_it->second.begin(), self_it->second.end(), [this, term](uint32_t term_id)
+    {
+        return terms_[term_id] == term;
+    });
+    if (id_it == self_it->second.end())
+    {
+        return;
+    }
+    const uint32_t term_id = *id_it;
+
+    for (const size_t hash : GetDeletionHashes(term, std::pmr::get_default_resource()))
+    {
+        const auto bucket_it = deletions_.find(hash);
+        std::pmr::vector<uint32_t>& term_ids = bucket_it->second;
+        term_ids.erase(std::remove(term_ids.begin(), term_ids.end(), term_id), term_ids.end());
+        if (term_ids.empty())
+        {
+            deletions_.erase(bucket_it);
+        }
+    }
+    terms_[term_id].clear();
+    free_terms_.push_back(term_id);
+}
+
+size_t DeletionIndex::GetMemoryBytes() const
+{
+    size_t bytes = terms_.capacity() * sizeof(std::pmr::string) + free_terms_.capacity() * sizeof(uint32_t)
+                 + deletions_.bucket_count() * sizeof(void*);
+    for (const std::pmr::string& term : terms_)
+    {
+        bytes += HeapBytes(term);
+    }
+    for (const auto& [hash, term_ids] : deletions_)
+    {
+        bytes += HASH_NODE_OVERHEAD + sizeof(hash) + sizeof(term_ids) + term_ids.capacity() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+std::pmr::vector<size_t> DeletionIndex::GetDeletionHashes(std::string_view word, std::pmr::memory_resource* resource) const
+{
+    std::pmr::vector<size_t> hashes(resource);
+    std::string prefix(word.substr(0, DELETION_PREFIX_LENGTH)); // короткая строка, без выделения памяти
+    CollectDeletions(prefix, 0, max_distance_, hashes);
+    // повторы дают слова с одинаковыми буквами подряд
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+}
+
+std::pmr::vector<uint32_t> DeletionIndex::FindCandidates(std::string_view word, std::pmr::memory_resource* resource) const
+{
+    std::pmr::vector<uint32_t> candidates(resource);
+    for (const size_t hash : GetDeletionHashes(word, resource))
+    {
+        const auto bucket_it = deletions_.find(hash);
+        if (bucket_it != deletions_.end())
+        {
+            candidates.insert(candidates.end(), bucket_it->second.begin(), bucket_it->second.end());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    return candidates;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// расстояние Дамерау-Левенштейна (с перестановкой соседних символов);
+// если оно больше limit, возвращается limit + 1
+size_t EditDistance(std::string_view lhs, std::string_view rhs, size_t limit);
+
+const size_t DELETION_PREFIX_LENGTH = 7; // удаления строятся только из начала слова такой длины
+
+// Индекс удалений (SymSpell): каждое слово словаря записано под всеми строками,
+// получающимися из его префикса длины DELETION_PREFIX_LENGTH удалением до max_distance символов.
+// Префиксы слов на расстоянии не больше max_distance от запроса имеют с префиксом запроса
+// общую такую строку, поэтому кандидаты находятся поиском по хешу, без просмотра словаря.
+// Ограничение префикса делает число удалений независимым от длины слова.
+class DeletionIndex
+{
+public:
+    DeletionIndex(size_t max_distance, std::pmr::memory_resource* resource);
+
+    void AddTerm(std::string_view term);
+    void RemoveTerm(std::string_view term);
+
+    // callback(term, distance) для слов словаря на наименьшем расстоянии от 1 до max_distance;
+    // scratch - память для промежуточных списков
+    template <typename Callback>
+    void ForEachCorrection(std::string_view word, std::pmr::memory_resource* scratch, Callback callback) const;
+
+    inline size_t GetMaxDistance() const
+    {
+        return max_distance_;
+    }
+
+    size_t GetMemoryBytes() const;
+
+private:
+    // хеши всех строк, получаемых удалением до max_distance символов, включая само слово
+    std::pmr::vector<size_t> GetDeletionHashes(std::string_view word, std::pmr::memory_resource* resource) const;
+    std::pmr::vector<uint32_t> FindCandidates(std::string_view word, std::pmr::memory_resource* resource) const;
+
+    size_t max_distance_;
+    std::pmr::vector<std::pmr::string> terms_; // пустая строка - освободившийся номер
+    std::pmr::vector<uint32_t> free_terms_;
+    // коллизии хешей безопасны: каждый кандидат проверяется честным расстоянием
+    std::pmr::unordered_map<size_t, std::pmr::vector<uint32_t>> deletions_;
+};
+
+template <typename Callback>
+void DeletionIndex::ForEachCorrection(std::string_view word, std::pmr::memory_resource* scratch, Callback callback) const
+{
+    const std::pmr::vector<uint32_t> candidates = FindCandidates(word, scratch);
+    std::pmr::vector<size_t> distances(candidates.size(), 0, scratch);
+    size_t best = max_distance_ + 1;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        distances[i] = EditDistance(word, terms_[candidates[i]], max_distance_);
+        if (distances[i] != 0 && distances[i] < best)
+        {
+            best = distances[i];
+        }
+    }
+    if (best > max_distance_) // кандидаты с общей строкой удалений бывают и дальше max_distance
+    {
+        return;
+    }
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        if (distances[i] == best)
+        {
+            callback(std::string_view(terms_[candidates[i]]), best);
+        }
+    }
+}
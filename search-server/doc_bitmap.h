@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Битовое множество внутренних номеров документов
+class DocBitmap
+{
+public:
+    explicit DocBitmap(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : words_(resource)
+    {
+
+    }
+
+    inline void Set(size_t index)
+    {
+        if (index / 64 >= words_.size())
+        {
+            words_.resize(index / 64 + 1, 0);
+        }
+        words_[index / 64] |= uint64_t{1} << (index % 64);
+    }
+
+    inline void Reset(size_t index)
+    {
+        if (index / 64 < words_.size())
+        {
+            words_[index / 64] &= ~(uint64_t{1} << (index % 64));
+        }
+    }
+
+    inline bool Test(size_t index) const
+    {
+        return index / 64 < words_.size() && (words_[index / 64] >> (index % 64) & 1) != 0;
+    }
+
+    inline void Clear()
+    {
+        words_.clear();
+    }
+
+    inline size_t GetMemoryBytes() const
+    {
+        return words_.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    std::pmr::vector<uint64_t> words_;
+};
@@ -10,6 +10,8 @@ enum struct DocumentStatus
     REMOVED
 };
 
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
 struct Document
 {
     Document() : id(0), relevance(0.0), rating(0){}
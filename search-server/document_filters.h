@@ -0,0 +1,27 @@
+#pragma once
+#include "document.h"
+
+// Предикаты, которые SearchServer распознаёт на этапе компиляции и применяет
+// до подсчёта релевантности. Любые другие предикаты вызываются как раньше.
+
+struct StatusFilter
+{
+    DocumentStatus status;
+
+    inline bool operator()(int document_id, DocumentStatus document_status, int rating) const
+    {
+        return document_status == status;
+    }
+};
+
+// рейтинг в отрезке [min_rating, max_rating]
+struct RatingRange
+{
+    int min_rating;
+    int max_rating;
+
+    inline bool operator()(int document_id, DocumentStatus document_status, int rating) const
+    {
+        return rating >= min_rating && rating <= max_rating;
+    }
+};
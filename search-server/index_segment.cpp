@@ -0,0 +1,341 @@
+#include "index_segment.h"
+#include <algorithm>
+#include <numeric>
+
+const Posting* FindPosting(PostingSpan postings, DocIndex doc)
+{
+    const Posting* it = std::lower_bound(postings.begin(), postings.end(), doc, [](const Posting& posting, DocIndex value)
+    {
+        return posting.doc < value;
+    });
+    return it != postings.end() && it->doc == doc ? it : nullptr;
+}
+
+const Posting* SeekPosting(const Posting* from, const Posting* last, DocIndex target)
+{
+    const auto before_target = [target](const Posting& posting, DocIndex)
+    {
+        return posting.doc < target;
+    };
+    if (static_cast<size_t>(last - from) < POSTING_BLOCK_SIZE)
+    {
+        return std::lower_bound(from, last, target, before_target);
+    }
+    if (from[POSTING_BLOCK_SIZE - 1].doc >= target)
+    {
+        // ответ внутри блока: считаем меньшие документы, цикл фиксированной длины векторизуется
+        size_t below = 0;
+        for (size_t i = 0; i < POSTING_BLOCK_SIZE; ++i)
+        {
+            below += from[i].doc < target ? 1 : 0;
+        }
+        return from + below;
+    }
+
+    // low всегда меньше target, ответ где-то в (low, low + step]
+    const Posting* low = from + POSTING_BLOCK_SIZE - 1;
+    size_t step = POSTING_BLOCK_SIZE;
+    while (step < static_cast<size_t>(last - low) && low[step].doc < target)
+    {
+        low += step;
+        step *= 2;
+    }
+    const Posting* high = step < static_cast<size_t>(last - low) ? low + step + 1 : last;
+    return std::lower_bound(low + 1, high, target, before_target);
+}
+
+MutableSegment::MutableSegment(DocIndex first_doc, bool keep_document_words, std::pmr::memory_resource* resource)
+    : first_doc_(first_doc)
+    , keeps_document_words_(keep_document_words)
+    , word_to_postings_(resource)
+    , document_word_offsets_(resource)
+    , document_words_(resource)
+{
+
+}
+
+bool MutableSegment::AddPosting(std::string_view word, DocIndex doc, double tf)
+{
+    auto word_it = word_to_postings_.find(word);
+    if (word_it == word_to_postings_.end())
+    {
+        word_it = word_to_postings_.try_emplace(std::pmr::string(word, word_to_postings_.get_allocator())).first;
+    }
+    std::pmr::vector<Posting>& postings = word_it->second;
+    const bool first_in_document = postings.empty() || postings.back().doc != doc;
+    if (first_in_document)
+    {
+        postings.push_back({doc, 0.0});
+        if (keeps_document_words_)
+        {
+            while (document_word_offsets_.size() <= doc - first_doc_)
+            {
+                document_word_offsets_.push_back(static_cast<uint32_t>(document_words_.size()));
+            }
+            document_words_.push_back(&*word_it);
+        }
+    }
+    postings.back().tf += tf;
+    return first_in_document;
+}
+
+PostingSpan MutableSegment::Find(std::string_view word) const
+{
+    const auto word_it = word_to_postings_.find(word);
+    if (word_it == word_to_postings_.end())
+    {
+        return {};
+    }
+    const std::pmr::vector<Posting>& postings = word_it->second;
+    return {postings.data(), postings.data() + postings.size()};
+}
+
+size_t MutableSegment::GetTermBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& [word, postings] : word_to_postings_)
+    {
+        bytes += TREE_NODE_OVERHEAD + sizeof(word) + sizeof(postings) + HeapBytes(word);
+    }
+    return bytes;
+}
+
+size_t MutableSegment::GetPostingBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& [word, postings] : word_to_postings_)
+    {
+        bytes += postings.capacity() * sizeof(Posting);
+    }
+    return bytes;
+}
+
+size_t MutableSegment::GetDocumentWordBytes() const
+{
+    return document_word_offsets_.capacity() * sizeof(uint32_t) + document_words_.capacity() * sizeof(void*);
+}
+
+ImmutableSegment::ImmutableSegment(std::pmr::memory_resource* resource)
+    : word_data_(resource)
+    , word_offsets_(1, 0, resource)
+    , posting_offsets_(1, 0, resource)
+    , postings_(resource)
+    , document_word_offsets_(resource)
+    , document_words_(resource)
+{
+
+}
+
+ImmutableSegment ImmutableSegment::Freeze(const MutableSegment& segment, DocIndex end_doc, std::pmr::memory_resource* resource)
+{
+    ImmutableSegment result(resource);
+    result.first_doc_ = segment.first_doc_;
+    result.end_doc_ = end_doc;
+    result.document_count_ = end_doc - segment.first_doc_;
+    result.keeps_document_words_ = segment.keeps_document_words_;
+
+    size_t posting_count = 0;
+    for (const auto& [word, postings] : segment.word_to_postings_)
+    {
+        posting_count += postings.size();
+    }
+    result.word_offsets_.reserve(segment.word_to_postings_.size() + 1);
+    result.posting_offsets_.reserve(segment.word_to_postings_.size() + 1);
+    result.postings_.reserve(posting_count);
+
+    for (const auto& [word, postings] : segment.word_to_postings_)
+    {
+        result.AppendWord(word);
+        result.postings_.insert(result.postings_.end(), postings.begin(), postings.end());
+        result.posting_offsets_.push_back(static_cast<uint32_t>(result.postings_.size()));
+    }
+    if (result.keeps_document_words_)
+    {
+        result.BuildDocumentWords();
+    }
+    return result;
+}
+
+ImmutableSegment ImmutableSegment::Merge(const std::vector<const ImmutableSegment*>& parts, const DocBitmap& alive,
+                                         const std::vector<DocIndex>* remap, std::pmr::memory_resource* resource)
+{
+    ImmutableSegment result(resource);
+    if (parts.empty())
+    {
+        return result;
+    }
+    result.keeps_document_words_ = parts.front()->keeps_document_words_;
+
+    const auto map_doc = [remap](DocIndex doc)
+    {
+        return remap == nullptr ? doc : (*remap)[doc];
+    };
+
+    DocIndex first_alive = parts.back()->end_doc_;
+    DocIndex last_alive = 0;
+    for (const ImmutableSegment* part : parts)
+    {
+        for (DocIndex doc = part->first_doc_; doc < part->end_doc_; ++doc)
+        {
+            if (alive.Test(doc))
+            {
+                first_alive = std::min(first_alive, doc);
+                last_alive = doc;
+                ++result.document_count_;
+            }
+        }
+    }
+    if (result.document_count_ == 0)
+    {
+        return result;
+    }
+    // без перенумерации сегмент сохраняет свой диапазон, иначе сжимается до живых документов
+    result.first_doc_ = remap == nullptr ? parts.front()->first_doc_ : map_doc(first_alive);
+    result.end_doc_ = remap == nullptr ? parts.back()->end_doc_ : map_doc(last_alive) + 1;
+
+    // слияние отсортированных словарей; части идут по возрастанию документов,
+    // поэтому списки одного слова просто дописываются друг за другом
+    std::vector<size_t> cursors(parts.size(), 0);
+    while (true)
+    {
+        std::string_view word;
+        bool found = false;
+        for (size_t i = 0; i < parts.size(); ++i)
+        {
+            if (cursors[i] < parts[i]->GetWordCount())
+            {
+                const std::string_view candidate = parts[i]->GetWord(cursors[i]);
+                if (!found || candidate < word)
+                {
+                    word = candidate;
+                    found = true;
+                }
+            }
+        }
+        if (!found)
+        {
+            break;
+        }
+
+        const size_t postings_before = result.postings_.size();
+        for (size_t i = 0; i < parts.size(); ++i)
+        {
+            if (cursors[i] < parts[i]->GetWordCount() && parts[i]->GetWord(cursors[i]) == word)
+            {
+                for (const Posting& posting : parts[i]->GetPostings(cursors[i]))
+                {
+                    if (alive.Test(posting.doc))
+                    {
+                        result.postings_.push_back({map_doc(posting.doc), posting.tf});
+                    }
+                }
+                ++cursors[i];
+            }
+        }
+        if (result.postings_.size() != postings_before) // слово осталось хотя бы в одном живом документе
+        {
+            result.AppendWord(word);
+            result.posting_offsets_.push_back(static_cast<uint32_t>(result.postings_.size()));
+        }
+    }
+    if (result.keeps_document_words_)
+    {
+        result.BuildDocumentWords();
+    }
+    return result;
+}
+
+PostingSpan ImmutableSegment::Find(std::string_view word) const
+{
+    size_t left = 0;
+    size_t right = GetWordCount();
+    while (left < right)
+    {
+        const size_t middle = left + (right - left) / 2;
+        if (GetWord(middle) < word)
+        {
+            left = middle + 1;
+        }
+        else
+        {
+            right = middle;
+        }
+    }
+    if (left < GetWordCount() && GetWord(left) == word)
+    {
+        return GetPostings(left);
+    }
+    return {};
+}
+
+size_t ImmutableSegment::GetTermBytes() const
+{
+    return HeapBytes(word_data_) + word_offsets_.capacity() * sizeof(uint32_t);
+}
+
+size_t ImmutableSegment::GetPostingBytes() const
+{
+    return posting_offsets_.capacity() * sizeof(uint32_t) + postings_.capacity() * sizeof(Posting);
+}
+
+size_t ImmutableSegment::GetDocumentWordBytes() const
+{
+    return document_word_offsets_.capacity() * sizeof(uint32_t) + document_words_.capacity();
+}
+
+std::string_view ImmutableSegment::GetWord(size_t index) const
+{
+    return std::string_view(word_data_).substr(word_offsets_[index], word_offsets_[index + 1] - word_offsets_[index]);
+}
+
+PostingSpan ImmutableSegment::GetPostings(size_t index) const
+{
+    return {postings_.data() + posting_offsets_[index], postings_.data() + posting_offsets_[index + 1]};
+}
+
+void ImmutableSegment::AppendWord(std::string_view word)
+{
+    word_data_.append(word);
+    word_offsets_.push_back(static_cast<uint32_t>(word_data_.size()));
+}
+
+void ImmutableSegment::BuildDocumentWords()
+{
+    // подсчётом раскладываем номера слов по документам; слова перебираются
+    // по алфавиту, поэтому у каждого документа номера сразу упорядочены
+    const size_t document_range = end_doc_ - first_doc_;
+    std::vector<uint32_t> starts(document_range + 1, 0);
+    for (const Posting& posting : postings_)
+    {
+        ++starts[posting.doc - first_doc_ + 1];
+    }
+    std::partial_sum(starts.begin(), starts.end(), starts.begin());
+    std::vector<uint32_t> word_indexes(postings_.size());
+    std::vector<uint32_t> next(starts.begin(), starts.end() - 1);
+    for (size_t word_index = 0; word_index < GetWordCount(); ++word_index)
+    {
+        for (const Posting& posting : GetPostings(word_index))
+        {
+            word_indexes[next[posting.doc - first_doc_]++] = static_cast<uint32_t>(word_index);
+        }
+    }
+
+    document_word_offsets_.reserve(document_range + 1);
+    document_word_offsets_.push_back(0);
+    for (size_t i = 0; i < document_range; ++i)
+    {
+        uint32_t previous = 0;
+        for (size_t j = starts[i]; j < starts[i + 1]; ++j)
+        {
+            uint32_t delta = word_indexes[j] - previous;
+            previous = word_indexes[j];
+            while (delta >= 0x80)
+            {
+                document_words_.push_back(static_cast<uint8_t>(delta | 0x80));
+                delta >>= 7;
+            }
+            document_words_.push_back(static_cast<uint8_t>(delta));
+        }
+        document_word_offsets_.push_back(static_cast<uint32_t>(document_words_.size()));
+    }
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "doc_bitmap.h"
+#include "memory_stats.h"
+
+// внутренний плотный номер документа
+using DocIndex = uint32_t;
+
+struct Posting
+{
+    DocIndex doc;
+    double tf;
+};
+
+// непрерывный отрезок списка документов одного слова, упорядочен по DocIndex
+struct PostingSpan
+{
+    const Posting* first = nullptr;
+    const Posting* last = nullptr;
+
+    inline const Posting* begin() const
+    {
+        return first;
+    }
+
+    inline const Posting* end() const
+    {
+        return last;
+    }
+
+    inline size_t size() const
+    {
+        return last - first;
+    }
+
+    inline bool empty() const
+    {
+        return first == last;
+    }
+};
+
+const Posting* FindPosting(PostingSpan postings, DocIndex doc);
+
+const size_t POSTING_BLOCK_SIZE = 8; // столько соседних документов сравнивается без ветвлений
+
+// первая позиция в [from, last), где doc >= target; сначала проверяется блок
+// из POSTING_BLOCK_SIZE документов, дальше галоп шагами 8, 16, 32... и двоичный поиск
+const Posting* SeekPosting(const Posting* from, const Posting* last, DocIndex target);
+
+// Изменяемый сегмент: сюда попадают новые документы.
+// Документы добавляются по возрастанию DocIndex, начиная с first_doc.
+// С keep_document_words сегмент помнит слова каждого документа (режим COMPACT без прямого индекса).
+class MutableSegment
+{
+public:
+    MutableSegment(DocIndex first_doc, bool keep_document_words, std::pmr::memory_resource* resource);
+
+    // возвращает true, если слово встретилось в документе впервые
+    bool AddPosting(std::string_view word, DocIndex doc, double tf);
+    PostingSpan Find(std::string_view word) const;
+
+    // callback(word, tf) для слов документа; только с keep_document_words
+    template <typename Callback>
+    void ForEachWordOf(DocIndex doc, Callback callback) const;
+
+    inline DocIndex GetFirstDoc() const
+    {
+        return first_doc_;
+    }
+
+    size_t GetTermBytes() const;
+    size_t GetPostingBytes() const;
+    size_t GetDocumentWordBytes() const;
+
+private:
+    friend class ImmutableSegment;
+
+    using WordToPostings = std::pmr::map<std::pmr::string, std::pmr::vector<Posting>, std::less<>>;
+
+    DocIndex first_doc_;
+    bool keeps_document_words_;
+    WordToPostings word_to_postings_;
+    // узлы словаря не перемещаются, поэтому слова документа first_doc_ + i хранятся
+    // указателями на них, начиная с document_word_offsets_[i]
+    std::pmr::vector<uint32_t> document_word_offsets_;
+    std::pmr::vector<const WordToPostings::value_type*> document_words_;
+};
+
+// Неизменяемый сегмент, оптимизированный для чтения: отсортированный словарь
+// и все списки документов в одном массиве. Покрывает документы [first_doc, end_doc).
+// Слова документов хранятся, если их хранил исходный изменяемый сегмент.
+class ImmutableSegment
+{
+public:
+    static ImmutableSegment Freeze(const MutableSegment& segment, DocIndex end_doc, std::pmr::memory_resource* resource);
+
+    // склеивает соседние сегменты, выбрасывая удалённые документы;
+    // remap (если задан) перенумеровывает документы с сохранением порядка
+    static ImmutableSegment Merge(const std::vector<const ImmutableSegment*>& parts, const DocBitmap& alive,
+                                  const std::vector<DocIndex>* remap, std::pmr::memory_resource* resource);
+
+    PostingSpan Find(std::string_view word) const;
+
+    // callback(word, tf) для слов документа по алфавиту; только если слова документов хранятся
+    template <typename Callback>
+    void ForEachWordOf(DocIndex doc, Callback callback) const;
+
+    inline DocIndex GetFirstDoc() const
+    {
+        return first_doc_;
+    }
+
+    inline DocIndex GetEndDoc() const
+    {
+        return end_doc_;
+    }
+
+    inline size_t GetDocumentCount() const
+    {
+        return document_count_;
+    }
+
+    inline size_t GetWordCount() const
+    {
+        return word_offsets_.size() - 1;
+    }
+
+    size_t GetTermBytes() const;
+    size_t GetPostingBytes() const;
+    size_t GetDocumentWordBytes() const;
+
+private:
+    explicit ImmutableSegment(std::pmr::memory_resource* resource);
+
+    std::string_view GetWord(size_t index) const;
+    PostingSpan GetPostings(size_t index) const;
+    void AppendWord(std::string_view word);
+    // обращает списки документов в номера слов каждого документа
+    void BuildDocumentWords();
+
+    DocIndex first_doc_ = 0;
+    DocIndex end_doc_ = 0;
+    size_t document_count_ = 0;
+    bool keeps_document_words_ = false;
+    std::pmr::string word_data_;                // все слова подряд
+    std::pmr::vector<uint32_t> word_offsets_;    // начало i-го слова в word_data_
+    std::pmr::vector<uint32_t> posting_offsets_; // начало списка i-го слова в postings_
+    std::pmr::vector<Posting> postings_;
+    // номера слов документа first_doc_ + i по возрастанию, разностями в varint,
+    // начиная с document_word_offsets_[i]
+    std::pmr::vector<uint32_t> document_word_offsets_;
+    std::pmr::vector<uint8_t> document_words_;
+};
+
+template <typename Callback>
+void MutableSegment::ForEachWordOf(DocIndex doc, Callback callback) const
+{
+    const size_t index = doc - first_doc_;
+    if (index >= document_word_offsets_.size()) // у последних документов могли быть одни стоп-слова
+    {
+        return;
+    }
+    const size_t last = index + 1 < document_word_offsets_.size() ? document_word_offsets_[index + 1] : document_words_.size();
+    for (size_t i = document_word_offsets_[index]; i < last; ++i)
+    {
+        const auto& [word, postings] = *document_words_[i];
+        callback(std::string_view(word), FindPosting({postings.data(), postings.data() + postings.size()}, doc)->tf);
+    }
+}
+
+template <typename Callback>
+void ImmutableSegment::ForEachWordOf(DocIndex doc, Callback callback) const
+{
+    const uint8_t* it = document_words_.data() + document_word_offsets_[doc - first_doc_];
+    const uint8_t* last = document_words_.data() + document_word_offsets_[doc - first_doc_ + 1];
+    size_t word_index = 0;
+    while (it != last)
+    {
+        uint32_t delta = 0;
+        for (int shift = 0; ; shift += 7) // varint: по 7 бит, старший бит - продолжение
+        {
+            delta |= static_cast<uint32_t>(*it & 0x7F) << shift;
+            if ((*it++ & 0x80) == 0)
+            {
+                break;
+            }
+        }
+        word_index += delta;
+        callback(GetWord(word_index), FindPosting(GetPostings(word_index), doc)->tf);
+    }
+}
@@ -0,0 +1,126 @@
+#include "line_reader.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std::literals;
+
+int OpenForReading(const std::string& path)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open "s + path + ": "s + std::strerror(errno));
+    }
+    return fd;
+}
+
+LineReader::LineReader(int fd, size_t chunk_size) : fd_(fd)
+{
+    struct stat info;
+    if (::fstat(fd_, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        void* data = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (data != MAP_FAILED)
+        {
+            ::madvise(data, info.st_size, MADV_SEQUENTIAL);
+            mapped_ = static_cast<const char*>(data);
+            mapped_size_ = info.st_size;
+            pending_ = std::string_view(mapped_, mapped_size_);
+            eof_ = true;
+            return;
+        }
+    }
+    buffer_.resize(chunk_size);
+}
+
+LineReader::~LineReader()
+{
+    if (mapped_ != nullptr)
+    {
+        ::munmap(const_cast<char*>(mapped_), mapped_size_);
+    }
+}
+
+bool LineReader::NextLine(std::string_view& line)
+{
+    while (true)
+    {
+        const size_t end_of_line = pending_.find('\n');
+        if (end_of_line != std::string_view::npos)
+        {
+            line = pending_.substr(0, end_of_line);
+            pending_.remove_prefix(end_of_line + 1);
+            break;
+        }
+        if (eof_)
+        {
+            if (pending_.empty())
+            {
+                return false;
+            }
+            line = pending_;
+            pending_ = {};
+            break;
+        }
+        Refill();
+    }
+
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
+    return true;
+}
+
+bool LineReader::Refill()
+{
+    // недочитанный хвост переносим в начало буфера
+    const size_t tail = pending_.size();
+    if (tail != 0)
+    {
+        std::memmove(buffer_.data(), pending_.data(), tail);
+    }
+    if (tail == buffer_.size()) // строка длиннее буфера
+    {
+        buffer_.resize(buffer_.size() * 2);
+    }
+
+    ssize_t bytes_read = 0;
+    do
+    {
+        bytes_read = ::read(fd_, buffer_.data() + tail, buffer_.size() - tail);
+    } while (bytes_read < 0 && errno == EINTR);
+
+    if (bytes_read < 0)
+    {
+        throw std::runtime_error("Read error: "s + std::strerror(errno));
+    }
+    eof_ = bytes_read == 0;
+    pending_ = std::string_view(buffer_.data(), tail + bytes_read);
+    return !eof_;
+}
+
+std::vector<std::string> ReadQueries(int fd)
+{
+    std::vector<std::string> queries;
+    LineReader reader(fd);
+    std::string_view line;
+    while (reader.NextLine(line))
+    {
+        if (!line.empty())
+        {
+            queries.emplace_back(line);
+        }
+    }
+    return queries;
+}
+
+std::vector<std::string> ReadQueries(const std::string& path)
+{
+    FdGuard guard{OpenForReading(path)};
+    return ReadQueries(guard.fd);
+}
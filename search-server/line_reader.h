@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+
+// Построчное чтение из файлового дескриптора без iostream:
+// обычный файл отображается в память целиком, канал читается большими кусками.
+class LineReader
+{
+public:
+    explicit LineReader(int fd, size_t chunk_size = 1 << 20);
+    ~LineReader();
+
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    // строка без '\n' действительна до следующего вызова
+    bool NextLine(std::string_view& line);
+
+private:
+    bool Refill();
+
+    int fd_;
+    const char* mapped_ = nullptr;
+    size_t mapped_size_ = 0;
+    std::vector<char> buffer_;
+    std::string_view pending_;
+    bool eof_ = false;
+};
+
+int OpenForReading(const std::string& path);
+
+// закрывает дескриптор при выходе из области видимости
+struct FdGuard
+{
+    int fd;
+    ~FdGuard()
+    {
+        ::close(fd);
+    }
+};
+
+// одна строка потока - один запрос, пустые строки пропускаются
+std::vector<std::string> ReadQueries(int fd);
+std::vector<std::string> ReadQueries(const std::string& path);
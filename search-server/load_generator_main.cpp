@@ -0,0 +1,266 @@
+// Нагрузочный клиент для search_service: держит по --depth запросов в полёте
+// на каждом из --connections соединений и печатает пропускную способность и задержки.
+//   load_generator --queries FILE [--socket PATH | --port N] [--connections N] [--depth N] [--requests N]
+// Сборка: g++ -std=c++17 -O2 -pthread load_generator_main.cpp line_reader.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "command_line.h"
+#include "line_reader.h"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace
+{
+    struct Options
+    {
+        string queries_path;
+        string unix_socket_path;
+        uint16_t tcp_port = 7000;
+        size_t connections = 8;
+        size_t depth = 16;
+        size_t requests = 100000;
+    };
+
+    struct ConnectionStats
+    {
+        vector<int64_t> latencies_us;
+        size_t errors = 0;
+    };
+
+    int Connect(const Options& options)
+    {
+        int fd = -1;
+        if (!options.unix_socket_path.empty())
+        {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, options.unix_socket_path.c_str(), sizeof(address.sun_path) - 1);
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+            {
+                throw runtime_error("Cannot connect to "s + options.unix_socket_path + ": "s + strerror(errno));
+            }
+        }
+        else
+        {
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(options.tcp_port);
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+            {
+                throw runtime_error("Cannot connect to 127.0.0.1:"s + to_string(options.tcp_port) + ": "s + strerror(errno));
+            }
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+        return fd;
+    }
+
+    void SendAll(int fd, const string& data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            const ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw runtime_error("send: "s + strerror(errno));
+            }
+            sent += result;
+        }
+    }
+
+    // конвейер: пока в полёте меньше depth запросов, дописываем новые, затем ждём ответы
+    ConnectionStats RunConnection(const Options& options, const vector<string>& queries, size_t first_query, size_t request_count)
+    {
+        ConnectionStats stats;
+        stats.latencies_us.reserve(request_count);
+        const int fd = Connect(options);
+        deque<Clock::time_point> in_flight;
+        string input;
+        char buffer[64 * 1024];
+        size_t sent = 0;
+
+        while (stats.latencies_us.size() < request_count)
+        {
+            string batch;
+            while (sent < request_count && in_flight.size() < options.depth)
+            {
+                batch += queries[(first_query + sent) % queries.size()];
+                batch += '\n';
+                in_flight.push_back(Clock::now());
+                ++sent;
+            }
+            if (!batch.empty())
+            {
+                SendAll(fd, batch);
+            }
+
+            const ssize_t bytes_read = recv(fd, buffer, sizeof(buffer), 0);
+            if (bytes_read <= 0)
+            {
+                if (bytes_read < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                close(fd);
+                throw runtime_error("Server closed the connection"s);
+            }
+            input.append(buffer, bytes_read);
+
+            size_t start = 0;
+            for (size_t end = input.find('\n'); end != string::npos; end = input.find('\n', start))
+            {
+                const auto now = Clock::now();
+                stats.latencies_us.push_back(chrono::duration_cast<chrono::microseconds>(now - in_flight.front()).count());
+                in_flight.pop_front();
+                if (input.compare(start, 3, "ERR"s) == 0)
+                {
+                    ++stats.errors;
+                }
+                start = end + 1;
+            }
+            input.erase(0, start);
+        }
+        close(fd);
+        return stats;
+    }
+
+    int64_t Percentile(const vector<int64_t>& sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+        const size_t index = min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+        return sorted[index];
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const string flag = argv[i];
+            if (i + 1 >= argc)
+            {
+                throw invalid_argument("No value for "s + flag);
+            }
+            const string value = argv[++i];
+            if (flag == "--queries"s)
+            {
+                options.queries_path = value;
+            }
+            else if (flag == "--socket"s)
+            {
+                options.unix_socket_path = value;
+            }
+            else if (flag == "--port"s)
+            {
+                options.tcp_port = ParsePort(value, flag);
+            }
+            else if (flag == "--connections"s)
+            {
+                options.connections = ParseCount(value, flag);
+            }
+            else if (flag == "--depth"s)
+            {
+                options.depth = ParseCount(value, flag);
+            }
+            else if (flag == "--requests"s)
+            {
+                options.requests = ParseCount(value, flag);
+            }
+            else
+            {
+                throw invalid_argument("Unknown option "s + flag);
+            }
+        }
+        if (options.queries_path.empty())
+        {
+            throw invalid_argument("--queries is required"s);
+        }
+        const vector<string> queries = ReadQueries(options.queries_path);
+        if (queries.empty())
+        {
+            throw invalid_argument("Query file is empty"s);
+        }
+
+        vector<ConnectionStats> stats(options.connections);
+        vector<string> failures;
+        mutex failures_mutex;
+        vector<thread> threads;
+        const auto start = Clock::now();
+        for (size_t i = 0; i < options.connections; ++i)
+        {
+            const size_t request_count = options.requests / options.connections + (i < options.requests % options.connections ? 1 : 0);
+            threads.emplace_back([&, i, request_count]
+            {
+                try
+                {
+                    stats[i] = RunConnection(options, queries, i * 7919, request_count);
+                }
+                catch (const exception& e)
+                {
+                    lock_guard lock(failures_mutex);
+                    failures.push_back(e.what());
+                }
+            });
+        }
+        for (thread& t : threads)
+        {
+            t.join();
+        }
+        const double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+        vector<int64_t> latencies;
+        size_t errors = 0;
+        for (const ConnectionStats& connection : stats)
+        {
+            latencies.insert(latencies.end(), connection.latencies_us.begin(), connection.latencies_us.end());
+            errors += connection.errors;
+        }
+        sort(latencies.begin(), latencies.end());
+
+        for (const string& failure : failures)
+        {
+            cerr << failure << endl;
+        }
+        cout << "requests:   "s << latencies.size() << " ("s << errors << " errors)"s << endl;
+        cout << "throughput: "s << static_cast<int64_t>(latencies.size() / seconds) << " req/s"s << endl;
+        cout << "latency us: p50="s << Percentile(latencies, 0.50) << " p90="s << Percentile(latencies, 0.90)
+             << " p99="s << Percentile(latencies, 0.99) << " p99.9="s << Percentile(latencies, 0.999)
+             << " max="s << (latencies.empty() ? 0 : latencies.back()) << endl;
+        return failures.empty() ? 0 : 1;
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+}
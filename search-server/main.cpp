@@ -1,9 +1,12 @@
 #include "paginator.h"
 #include "request_queue.h"
 #include "remove_duplicates.h"
+#include "test_search_server.h"
 
 using namespace std;
 int main() {
+    TestSearchServer();
+
     SearchServer search_server("and with"s);
 
     search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+
+// Оценка занимаемой индексом памяти в байтах по структурам
+struct MemoryStats
+{
+    size_t terms = 0;         // словари слов сегментов и счётчики документов по словам
+    size_t postings = 0;      // списки документов
+    size_t forward_index = 0; // слова каждого документа с TF
+    size_t metadata = 0;      // id, рейтинги, статусы и битовые карты
+    size_t stop_words = 0;
+    size_t fuzzy_index = 0;   // индекс удалений для нечёткого поиска
+
+    inline size_t Total() const
+    {
+        return terms + postings + forward_index + metadata + stop_words + fuzzy_index;
+    }
+};
+
+// служебная часть узла красно-чёрного дерева: цвет и три указателя
+const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+// узел хеш-таблицы с целым ключом: указатель на следующий узел
+const size_t HASH_NODE_OVERHEAD = sizeof(void*);
+
+// память строки вне самого объекта; короткие строки хранятся внутри него
+template <typename String>
+size_t HeapBytes(const String& text)
+{
+    const char* data = text.data();
+    const char* object = reinterpret_cast<const char*>(&text);
+    return data >= object && data < object + sizeof(text) ? 0 : text.capacity() + 1;
+}
@@ -0,0 +1,52 @@
+#include "query_arena.h"
+
+QueryArena::Scope::Scope()
+    : arena_(QueryArena::ForThisThread())
+    , resource_(arena_.depth_ == 0 ? arena_.Reset() : &*arena_.resource_)
+{
+    ++arena_.depth_;
+}
+
+QueryArena::Scope::~Scope()
+{
+    --arena_.depth_;
+}
+
+QueryArena::QueryArena(size_t initial_size) : buffer_(initial_size)
+{
+
+}
+
+std::pmr::memory_resource* QueryArena::Reset()
+{
+    resource_.reset(); // возвращает upstream_ всё, что было взято сверх буфера
+    if (upstream_.overflow_bytes != 0)
+    {
+        buffer_.resize(buffer_.size() * 2 + upstream_.overflow_bytes);
+        upstream_.overflow_bytes = 0;
+    }
+    resource_.emplace(buffer_.data(), buffer_.size(), &upstream_);
+    return &*resource_;
+}
+
+QueryArena& QueryArena::ForThisThread()
+{
+    thread_local QueryArena arena;
+    return arena;
+}
+
+void* QueryArena::OverflowCounter::do_allocate(size_t bytes, size_t alignment)
+{
+    overflow_bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void QueryArena::OverflowCounter::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool QueryArena::OverflowCounter::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+// Сбрасываемый монотонный буфер для временных структур одного запроса.
+// Если запрос не поместился в буфер, при следующем сбросе буфер увеличивается,
+// поэтому в установившемся режиме запросы не вызывают malloc.
+class QueryArena
+{
+public:
+    // Запрос в арене текущего потока. Внешняя область освобождает всё, что выделил
+    // предыдущий запрос. Вложенная (предикат пользователя снова вызвал поиск) ничего
+    // не освобождает: она выделяет дальше, и её память уходит вместе с внешним запросом.
+    class Scope
+    {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        inline std::pmr::memory_resource* GetResource() const
+        {
+            return resource_;
+        }
+
+    private:
+        QueryArena& arena_;
+        std::pmr::memory_resource* resource_;
+    };
+
+    explicit QueryArena(size_t initial_size = 64 * 1024);
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    // арена текущего потока
+    static QueryArena& ForThisThread();
+
+private:
+    // освобождает всё, что было выделено предыдущим запросом
+    std::pmr::memory_resource* Reset();
+
+    // считает байты, которые не поместились в основной буфер
+    class OverflowCounter : public std::pmr::memory_resource
+    {
+    public:
+        size_t overflow_bytes = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    std::vector<std::byte> buffer_;
+    OverflowCounter upstream_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+    size_t depth_ = 0; // открытые области Scope
+};
@@ -0,0 +1,50 @@
+#include "query_plan.h"
+
+namespace
+{
+    void PrintTerms(std::ostream& out, const std::vector<PlannedTerm>& terms)
+    {
+        using namespace std::literals;
+        for (const PlannedTerm& term : terms)
+        {
+            out << " "s << term.word << "(df = "s << term.document_count << ", weight = "s << term.weight << ")"s;
+        }
+        out << "\n"s;
+    }
+}
+
+std::ostream& operator<<(std::ostream& out, QueryStrategy strategy)
+{
+    using namespace std::literals;
+    switch (strategy)
+    {
+    case QueryStrategy::EXHAUSTIVE:
+        return out << "EXHAUSTIVE"s;
+    case QueryStrategy::PRUNED:
+        return out << "PRUNED"s;
+    case QueryStrategy::SPARSE:
+        return out << "SPARSE"s;
+    case QueryStrategy::CONJUNCTIVE:
+        return out << "CONJUNCTIVE"s;
+    }
+    return out;
+}
+
+std::ostream& operator<<(std::ostream& out, const QueryPlan& plan)
+{
+    using namespace std::literals;
+    out << "strategy: "s << plan.strategy << ", estimated cost: "s << plan.estimated_cost << "\n"s;
+    out << "plus:"s;
+    PrintTerms(out, plan.plus_terms);
+    out << "dropped:"s;
+    for (const std::string& word : plan.dropped_words)
+    {
+        out << " "s << word;
+    }
+    out << "\n"s;
+    out << "excluded before scoring:"s;
+    PrintTerms(out, plan.excluded_terms);
+    out << "checked after scoring:"s;
+    PrintTerms(out, plan.checked_terms);
+    return out;
+}
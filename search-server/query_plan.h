@@ -0,0 +1,33 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum struct QueryStrategy
+{
+    EXHAUSTIVE,  // все списки плюс-слов складываются в плотный массив релевантности
+    PRUNED,      // частые слова досчитываются только у документов, которые ещё могут попасть в топ
+    SPARSE,      // объединение списков слиянием по документам; без массива на все документы
+    CONJUNCTIVE  // пересечение списков, начиная с самого короткого; без массива на все документы
+};
+
+struct PlannedTerm
+{
+    std::string word;
+    size_t document_count = 0;
+    double weight = 0.0; // IDF, умноженный на штраф исправления; 0, если слово уже учтено
+};
+
+// план запроса, как его выбрал SearchServer
+struct QueryPlan
+{
+    QueryStrategy strategy = QueryStrategy::EXHAUSTIVE;
+    std::vector<PlannedTerm> plus_terms;     // в порядке обработки, от редких к частым
+    std::vector<std::string> dropped_words;  // плюс-слова и префиксы, которых нет в индексе
+    std::vector<PlannedTerm> excluded_terms; // минус-слова, исключающие документы до подсчёта релевантности
+    std::vector<PlannedTerm> checked_terms;  // частые минус-слова, проверяемые только у найденных документов
+    size_t estimated_cost = 0;               // примерное число просмотренных записей индекса
+};
+
+std::ostream& operator<<(std::ostream& out, QueryStrategy strategy);
+std::ostream& operator<<(std::ostream& out, const QueryPlan& plan);
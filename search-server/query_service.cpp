@@ -0,0 +1,537 @@
+#include "query_service.h"
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std::literals;
+
+namespace
+{
+    const uint64_t LISTENER_ID = UINT64_MAX;
+    const uint64_t WAKE_ID = UINT64_MAX - 1;
+    const size_t READ_CHUNK_SIZE = 64 * 1024;
+    const int MAX_EVENTS = 128;
+
+    [[noreturn]] void ThrowSystemError(const std::string& what)
+    {
+        throw std::runtime_error(what + ": "s + std::strerror(errno));
+    }
+
+    std::string FormatDocuments(const std::vector<Document>& documents)
+    {
+        std::string text = "OK "s + std::to_string(documents.size());
+        for (const Document& document : documents)
+        {
+            text += ' ';
+            text += std::to_string(document.id);
+            text += ':';
+            text += std::to_string(document.relevance);
+            text += ':';
+            text += std::to_string(document.rating);
+        }
+        return text;
+    }
+}
+
+QueryService::QueryService(const SearchServer& search_server, QueryServiceOptions options)
+    : search_server_(search_server)
+    , options_(std::move(options))
+{
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0)
+    {
+        ThrowSystemError("epoll_create1"s);
+    }
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0)
+    {
+        ThrowSystemError("eventfd"s);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKE_ID;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+    OpenListener();
+
+    for (size_t i = 0; i < options_.worker_count; ++i)
+    {
+        workers_.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+QueryService::~QueryService()
+{
+    {
+        std::lock_guard lock(queue_mutex_);
+        workers_stopping_ = true;
+    }
+    queue_changed_.notify_all();
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+
+    for (auto& [id, connection] : connections_)
+    {
+        ::close(connection.fd);
+    }
+    if (listen_fd_ >= 0)
+    {
+        ::close(listen_fd_);
+        if (!options_.unix_socket_path.empty())
+        {
+            ::unlink(options_.unix_socket_path.c_str());
+        }
+    }
+    if (wake_fd_ >= 0)
+    {
+        ::close(wake_fd_);
+    }
+    if (epoll_fd_ >= 0)
+    {
+        ::close(epoll_fd_);
+    }
+}
+
+void QueryService::OpenListener()
+{
+    if (!options_.unix_socket_path.empty())
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (options_.unix_socket_path.size() >= sizeof(address.sun_path))
+        {
+            throw std::invalid_argument("Socket path is too long"s);
+        }
+        std::strcpy(address.sun_path, options_.unix_socket_path.c_str());
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0)
+        {
+            ThrowSystemError("socket"s);
+        }
+        ::unlink(address.sun_path);
+        if (::bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+        {
+            ThrowSystemError("bind "s + options_.unix_socket_path);
+        }
+    }
+    else
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options_.tcp_port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0)
+        {
+            ThrowSystemError("socket"s);
+        }
+        const int enable = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        if (::bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0)
+        {
+            ThrowSystemError("bind 127.0.0.1:"s + std::to_string(options_.tcp_port));
+        }
+    }
+
+    if (::listen(listen_fd_, SOMAXCONN) < 0)
+    {
+        ThrowSystemError("listen"s);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER_ID;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+}
+
+void QueryService::Run()
+{
+    epoll_event events[MAX_EVENTS];
+    while (!stop_requested_)
+    {
+        const int count = ::epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ThrowSystemError("epoll_wait"s);
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            const uint64_t id = events[i].data.u64;
+            if (id == LISTENER_ID)
+            {
+                AcceptConnections();
+            }
+            else if (id == WAKE_ID)
+            {
+                DeliverResponses();
+            }
+            else if ((events[i].events & (EPOLLHUP | EPOLLERR)) != 0)
+            {
+                Close(id); // писать уже некому
+            }
+            else
+            {
+                if ((events[i].events & EPOLLIN) != 0)
+                {
+                    ReadFrom(id);
+                }
+                if ((events[i].events & EPOLLOUT) != 0)
+                {
+                    WriteTo(id);
+                }
+            }
+        }
+    }
+}
+
+void QueryService::Stop()
+{
+    stop_requested_ = true;
+    const uint64_t one = 1;
+    [[maybe_unused]] const ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void QueryService::AcceptConnections()
+{
+    while (true)
+    {
+        const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return; // EAGAIN или временная ошибка: остальные соединения примем на следующей итерации
+        }
+        if (options_.unix_socket_path.empty())
+        {
+            const int enable = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+
+        const uint64_t id = next_connection_id_++;
+        connections_[id].fd = fd;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void QueryService::ReadFrom(uint64_t connection_id)
+{
+    const auto connection_it = connections_.find(connection_id);
+    if (connection_it == connections_.end())
+    {
+        return;
+    }
+    Connection& connection = connection_it->second;
+
+    char buffer[READ_CHUNK_SIZE];
+    while (connection.reading)
+    {
+        const ssize_t bytes_read = ::read(connection.fd, buffer, sizeof(buffer));
+        if (bytes_read > 0)
+        {
+            connection.input.append(buffer, bytes_read);
+            ParseRequests(connection_id);
+            if (connection.input.size() > options_.max_request_length && connection.input.find('\n') == std::string::npos)
+            {
+                Close(connection_id);
+                return;
+            }
+        }
+        else if (bytes_read == 0)
+        {
+            // собеседник закрыл запись: последнюю строку считаем запросом, ответы дописываем
+            connection.peer_closed = true;
+            connection.reading = false;
+            if (!connection.input.empty() && connection.input.back() != '\n')
+            {
+                connection.input += '\n';
+            }
+            ParseRequests(connection_id);
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        else
+        {
+            Close(connection_id);
+            return;
+        }
+    }
+    UpdateInterest(connection_id);
+    CloseIfDone(connection_id);
+}
+
+void QueryService::ParseRequests(uint64_t connection_id)
+{
+    Connection& connection = connections_.at(connection_id);
+    std::vector<Request> parsed;
+    size_t start = 0;
+    while (true)
+    {
+        const size_t end_of_line = connection.input.find('\n', start);
+        if (end_of_line == std::string::npos)
+        {
+            break;
+        }
+        if (pending_requests_ >= options_.max_pending_requests || connection.in_flight >= options_.max_connection_requests)
+        {
+            // очередь полна: перестаём читать, пока рабочие потоки не освободят место
+            connection.reading = false;
+            reads_paused_ = true;
+            break;
+        }
+        size_t length = end_of_line - start;
+        if (length != 0 && connection.input[end_of_line - 1] == '\r')
+        {
+            --length;
+        }
+        parsed.push_back({connection_id, connection.next_sequence++, connection.input.substr(start, length)});
+        ++connection.in_flight;
+        ++pending_requests_;
+        start = end_of_line + 1;
+    }
+    connection.input.erase(0, start);
+
+    if (!parsed.empty())
+    {
+        {
+            std::lock_guard lock(queue_mutex_);
+            std::move(parsed.begin(), parsed.end(), std::back_inserter(requests_));
+        }
+        queue_changed_.notify_all();
+    }
+}
+
+void QueryService::DeliverResponses()
+{
+    uint64_t counter = 0;
+    [[maybe_unused]] const ssize_t bytes_read = ::read(wake_fd_, &counter, sizeof(counter));
+
+    std::vector<Response> responses;
+    {
+        std::lock_guard lock(queue_mutex_);
+        responses.swap(responses_);
+    }
+
+    std::vector<uint64_t> touched;
+    for (Response& response : responses)
+    {
+        --pending_requests_;
+        const auto connection_it = connections_.find(response.connection_id);
+        if (connection_it == connections_.end())
+        {
+            continue; // соединение закрыто, ответ никому не нужен
+        }
+        Connection& connection = connection_it->second;
+        --connection.in_flight;
+        connection.ready.emplace(response.sequence, std::move(response.text));
+        // ответы конвейера отправляются строго в порядке запросов
+        while (!connection.ready.empty() && connection.ready.begin()->first == connection.next_to_send)
+        {
+            connection.output += connection.ready.begin()->second;
+            connection.output += '\n';
+            connection.ready.erase(connection.ready.begin());
+            ++connection.next_to_send;
+        }
+        touched.push_back(response.connection_id);
+    }
+
+    for (const uint64_t connection_id : touched)
+    {
+        WriteTo(connection_id);
+    }
+    ResumePausedReads();
+}
+
+void QueryService::WriteTo(uint64_t connection_id)
+{
+    const auto connection_it = connections_.find(connection_id);
+    if (connection_it == connections_.end())
+    {
+        return;
+    }
+    Connection& connection = connection_it->second;
+
+    size_t written = 0;
+    while (written < connection.output.size())
+    {
+        const ssize_t result = ::send(connection.fd, connection.output.data() + written, connection.output.size() - written, MSG_NOSIGNAL);
+        if (result >= 0)
+        {
+            written += result;
+        }
+        else if (errno == EINTR)
+        {
+            continue;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        else
+        {
+            Close(connection_id);
+            return;
+        }
+    }
+    connection.output.erase(0, written);
+    connection.writing = !connection.output.empty();
+    UpdateInterest(connection_id);
+    CloseIfDone(connection_id);
+}
+
+void QueryService::ResumePausedReads()
+{
+    if (!reads_paused_)
+    {
+        return;
+    }
+    reads_paused_ = false;
+    std::vector<uint64_t> finished; // закрываем после обхода, чтобы не портить итераторы
+    for (auto& [connection_id, connection] : connections_)
+    {
+        if (connection.reading)
+        {
+            continue;
+        }
+        ParseRequests(connection_id);
+        const bool has_room = pending_requests_ < options_.max_pending_requests
+                              && connection.in_flight < options_.max_connection_requests;
+        if (!connection.peer_closed && has_room)
+        {
+            connection.reading = true;
+            UpdateInterest(connection_id);
+        }
+        else if (!connection.peer_closed || connection.input.find('\n') != std::string::npos)
+        {
+            reads_paused_ = true; // вернёмся к нему после следующей порции ответов
+        }
+        if (connection.peer_closed && connection.in_flight == 0 && connection.output.empty() && connection.input.empty())
+        {
+            finished.push_back(connection_id);
+        }
+    }
+    for (const uint64_t connection_id : finished)
+    {
+        Close(connection_id);
+    }
+}
+
+void QueryService::UpdateInterest(uint64_t connection_id)
+{
+    const auto connection_it = connections_.find(connection_id);
+    if (connection_it == connections_.end())
+    {
+        return;
+    }
+    const Connection& connection = connection_it->second;
+    epoll_event event{};
+    event.events = (connection.reading ? uint32_t{EPOLLIN} : 0u) | (connection.writing ? uint32_t{EPOLLOUT} : 0u);
+    event.data.u64 = connection_id;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void QueryService::CloseIfDone(uint64_t connection_id)
+{
+    const auto connection_it = connections_.find(connection_id);
+    if (connection_it == connections_.end())
+    {
+        return;
+    }
+    const Connection& connection = connection_it->second;
+    if (connection.peer_closed && connection.in_flight == 0 && connection.output.empty() && connection.input.empty())
+    {
+        Close(connection_id);
+    }
+}
+
+void QueryService::Close(uint64_t connection_id)
+{
+    const auto connection_it = connections_.find(connection_id);
+    if (connection_it == connections_.end())
+    {
+        return;
+    }
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, connection_it->second.fd, nullptr);
+    ::close(connection_it->second.fd);
+    connections_.erase(connection_it);
+}
+
+void QueryService::WorkerLoop()
+{
+    while (true)
+    {
+        std::vector<Request> batch;
+        {
+            std::unique_lock lock(queue_mutex_);
+            queue_changed_.wait(lock, [this] { return !requests_.empty() || workers_stopping_; });
+            if (workers_stopping_)
+            {
+                return;
+            }
+            while (!requests_.empty() && batch.size() < options_.max_batch_size)
+            {
+                batch.push_back(std::move(requests_.front()));
+                requests_.pop_front();
+            }
+        }
+
+        std::vector<std::string> queries;
+        queries.reserve(batch.size());
+        for (Request& request : batch)
+        {
+            queries.push_back(std::move(request.query));
+        }
+        std::vector<std::string> texts = ExecuteBatch(queries);
+
+        {
+            std::lock_guard lock(queue_mutex_);
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                responses_.push_back({batch[i].connection_id, batch[i].sequence, std::move(texts[i])});
+            }
+        }
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t written = ::write(wake_fd_, &one, sizeof(one));
+    }
+}
+
+std::vector<std::string> QueryService::ExecuteBatch(const std::vector<std::string>& queries) const
+{
+    // исключение, вылетевшее из параллельного алгоритма, завершает программу,
+    // поэтому ошибки ловятся внутри и превращаются в ответ ERR
+    std::vector<std::string> texts(queries.size());
+    std::transform(std::execution::par, queries.begin(), queries.end(), texts.begin(), [this](const std::string& query)
+    {
+        try
+        {
+            return FormatDocuments(search_server_.FindTopDocuments(query));
+        }
+        catch (const std::exception& e)
+        {
+            return "ERR "s + e.what();
+        }
+    });
+    return texts;
+}
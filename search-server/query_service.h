@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "search_server.h"
+
+// Протокол: одна строка - один запрос FindTopDocuments(query).
+// Ответ тоже одной строкой, в порядке запросов соединения:
+//   OK <n> <id>:<relevance>:<rating> ...
+//   ERR <сообщение>
+
+struct QueryServiceOptions
+{
+    std::string unix_socket_path; // если пусто, слушаем TCP на 127.0.0.1
+    uint16_t tcp_port = 7000;
+    size_t worker_count = 4;
+    size_t max_batch_size = 32;            // столько запросов рабочий поток забирает разом
+    size_t max_pending_requests = 4096;    // при заполнении очереди чтение из сокетов приостанавливается
+    size_t max_connection_requests = 256;  // запросов одного соединения без отправленного ответа
+    size_t max_request_length = 64 * 1024;
+};
+
+// Неблокирующий цикл событий на epoll и пул рабочих потоков.
+class QueryService
+{
+public:
+    QueryService(const SearchServer& search_server, QueryServiceOptions options);
+    ~QueryService();
+
+    QueryService(const QueryService&) = delete;
+    QueryService& operator=(const QueryService&) = delete;
+
+    // обслуживает соединения, пока не будет вызван Stop
+    void Run();
+    // можно вызывать из другого потока и из обработчика сигнала
+    void Stop();
+
+private:
+    struct Connection
+    {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        uint64_t next_sequence = 0;
+        uint64_t next_to_send = 0;
+        std::map<uint64_t, std::string> ready; // ответы, пришедшие раньше предыдущих
+        size_t in_flight = 0;
+        bool reading = true;
+        bool writing = false;
+        bool peer_closed = false;
+    };
+
+    struct Request
+    {
+        uint64_t connection_id;
+        uint64_t sequence;
+        std::string query;
+    };
+
+    struct Response
+    {
+        uint64_t connection_id;
+        uint64_t sequence;
+        std::string text;
+    };
+
+    void OpenListener();
+    void AcceptConnections();
+    void ReadFrom(uint64_t connection_id);
+    void WriteTo(uint64_t connection_id);
+    // превращает накопленные строки в запросы, пока есть место в очередях
+    void ParseRequests(uint64_t connection_id);
+    void DeliverResponses();
+    void ResumePausedReads();
+    void UpdateInterest(uint64_t connection_id);
+    void CloseIfDone(uint64_t connection_id);
+    void Close(uint64_t connection_id);
+
+    void WorkerLoop();
+    std::vector<std::string> ExecuteBatch(const std::vector<std::string>& queries) const;
+
+    const SearchServer& search_server_;
+    const QueryServiceOptions options_;
+
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stop_requested_ = false;
+
+    // состояние цикла событий, трогает только поток Run
+    std::unordered_map<uint64_t, Connection> connections_;
+    uint64_t next_connection_id_ = 0;
+    size_t pending_requests_ = 0;
+    bool reads_paused_ = false;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_changed_;
+    std::deque<Request> requests_;
+    std::vector<Response> responses_;
+    bool workers_stopping_ = false;
+    std::vector<std::thread> workers_;
+};
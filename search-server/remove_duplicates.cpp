@@ -10,7 +10,7 @@ void RemoveDuplicates(SearchServer& search_server)
         std::set<std::string> temp;
         for (const auto& [word, freq] : search_server.GetWordFrequencies(document_id))
         {
-            temp.insert(word);
+            temp.emplace(word);
         }
 
         if (set_words_to_id.count(temp) != 0)
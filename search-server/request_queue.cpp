@@ -7,7 +7,7 @@ RequestQueue::RequestQueue(const SearchServer& search_server) : server_(search_s
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status)
 {
-    return AddFindRequest(raw_query, [status](int id, DocumentStatus stat, int rating){ return stat == status;});
+    return AddFindRequest(raw_query, StatusFilter{status});
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query)
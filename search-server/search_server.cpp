@@ -2,67 +2,726 @@
 
 using namespace std::literals;
 
+SearchServer::SearchServer(StopWordSet stop_words, IndexMode mode, std::pmr::memory_resource* upstream)
+    : index_resource_(std::make_unique<std::pmr::synchronized_pool_resource>(upstream))
+    , mode_(mode)
+    , docs_id_(index_resource_.get())
+    , id_to_index_(index_resource_.get())
+    , index_to_id_(index_resource_.get())
+    , alive_(index_resource_.get())
+    , ratings_(index_resource_.get())
+    , statuses_(index_resource_.get())
+    , status_bitmaps_{DocBitmap(index_resource_.get()), DocBitmap(index_resource_.get()),
+                      DocBitmap(index_resource_.get()), DocBitmap(index_resource_.get())}
+    , index_to_word_freqs_(index_resource_.get())
+    , word_document_counts_(index_resource_.get())
+    , mutable_segment_(0, mode == IndexMode::COMPACT, index_resource_.get())
+    , stop_words_(std::move(stop_words))
+{
+    if (any_of(stop_words_.begin(), stop_words_.end(), [](const std::string& word) {return !IsValidWord(word);}))
+    {
+        throw std::invalid_argument("Word contains symbols with codes from 0 to 31"s);
+    }
+    merge_thread_ = std::thread([this] { MergeLoop(); });
+}
+
+SearchServer::~SearchServer()
+{
+    {
+        std::lock_guard lock(merge_mutex_);
+        stopping_ = true;
+    }
+    merge_requested_.notify_one();
+    merge_thread_.join();
+}
+
+SearchServer::DocumentScratch::DocumentScratch(size_t document_slots)
+    : arrays_([]() -> Arrays&
+    {
+        thread_local Arrays arrays;
+        return arrays;
+    }())
+{
+    if (arrays_.state.size() < document_slots)
+    {
+        arrays_.relevance.resize(document_slots, 0.0);
+        arrays_.state.resize(document_slots, UNSEEN);
+    }
+}
+
+SearchServer::DocumentScratch::~DocumentScratch()
+{
+    for (const DocIndex doc : arrays_.touched)
+    {
+        arrays_.relevance[doc] = 0.0;
+        arrays_.state[doc] = UNSEEN;
+    }
+    arrays_.touched.clear();
+}
+
+const std::vector<DocIndex>& SearchServer::DocumentScratch::SortTouched()
+{
+    std::sort(arrays_.touched.begin(), arrays_.touched.end());
+    return arrays_.touched;
+}
+
+void SearchServer::PoolDelete::operator()(WordFrequencies* word_freqs) const
+{
+    std::pmr::polymorphic_allocator<WordFrequencies> allocator(resource);
+    allocator.destroy(word_freqs);
+    allocator.deallocate(word_freqs, 1);
+}
+
 int SearchServer::GetDocumentCount() const
 {
+    std::shared_lock lock(index_mutex_);
     return docs_id_.size();
 }
 
-const std::set<int>::iterator SearchServer::begin()
+const std::pmr::set<int>::iterator SearchServer::begin()
 {
     return docs_id_.begin();
 }
 
-const std::set<int>::iterator SearchServer::end()
+const std::pmr::set<int>::iterator SearchServer::end()
 {
     return docs_id_.end();
 }
 
-const std::map<std::string, double>& SearchServer::GetWordFrequencies(int document_id) const
+const SearchServer::WordFrequencies& SearchServer::GetWordFrequencies(int document_id) const
 {
-    static const std::map<std::string, double> empty = {};
-    if (id_to_word_freqs_.count(document_id) != 0)
+    static const WordFrequencies empty = {};
+    std::shared_lock lock(index_mutex_);
+    const auto index_it = id_to_index_.find(document_id);
+    if (index_it == id_to_index_.end())
     {
-        return id_to_word_freqs_.at(document_id);
+        return empty;
     }
-    else
+    if (mode_ == IndexMode::FULL)
     {
-        return empty;
+        return *index_to_word_freqs_[index_it->second];
+    }
+
+    thread_local WordFrequencies rebuilt;
+    rebuilt.clear();
+    ForEachWordOf(index_it->second, [](std::string_view word, double tf)
+    {
+        rebuilt.try_emplace(std::pmr::string(word, rebuilt.get_allocator()), tf);
+    });
+    return rebuilt;
+}
+
+MemoryStats SearchServer::GetMemoryStats() const
+{
+    std::shared_lock lock(index_mutex_);
+    MemoryStats stats;
+
+    for (const auto& [word, count] : word_document_counts_)
+    {
+        stats.terms += TREE_NODE_OVERHEAD + sizeof(word) + sizeof(count) + HeapBytes(word);
+    }
+    for (const auto& segment : segments_)
+    {
+        stats.terms += sizeof(ImmutableSegment) + segment->GetTermBytes();
+        stats.postings += segment->GetPostingBytes();
+    }
+    stats.terms += mutable_segment_.GetTermBytes();
+    stats.postings += mutable_segment_.GetPostingBytes();
+
+    // в режиме COMPACT прямой индекс - номера слов документов внутри сегментов
+    stats.forward_index = index_to_word_freqs_.capacity() * sizeof(WordFrequenciesPtr) + mutable_segment_.GetDocumentWordBytes();
+    for (const auto& segment : segments_)
+    {
+        stats.forward_index += segment->GetDocumentWordBytes();
+    }
+    for (const auto& word_freqs : index_to_word_freqs_)
+    {
+        if (!word_freqs)
+        {
+            continue;
+        }
+        stats.forward_index += sizeof(WordFrequencies);
+        for (const auto& [word, freq] : *word_freqs)
+        {
+            stats.forward_index += TREE_NODE_OVERHEAD + sizeof(word) + sizeof(freq) + HeapBytes(word);
+        }
+    }
+
+    stats.metadata = docs_id_.size() * (TREE_NODE_OVERHEAD + sizeof(int))
+                   + id_to_index_.size() * (HASH_NODE_OVERHEAD + sizeof(std::pair<const int, DocIndex>))
+                   + id_to_index_.bucket_count() * sizeof(void*)
+                   + index_to_id_.capacity() * sizeof(int)
+                   + ratings_.capacity() * sizeof(int)
+                   + statuses_.capacity() * sizeof(DocumentStatus)
+                   + alive_.GetMemoryBytes();
+    for (const DocBitmap& bitmap : status_bitmaps_)
+    {
+        stats.metadata += bitmap.GetMemoryBytes();
+    }
+
+    stats.terms += term_filter_.GetMemoryBytes();
+    stats.stop_words = stop_words_.GetMemoryBytes();
+    stats.fuzzy_index = fuzzy_index_ ? fuzzy_index_->GetMemoryBytes() : 0;
+    return stats;
+}
+
+void SearchServer::SetFuzzyMatching(size_t max_distance, double correction_weight)
+{
+    if (max_distance > MAX_FUZZY_DISTANCE)
+    {
+        throw std::invalid_argument("Edit distance is greater than "s + std::to_string(MAX_FUZZY_DISTANCE));
+    }
+    if (!(correction_weight > 0.0 && correction_weight <= 1.0))
+    {
+        throw std::invalid_argument("Correction weight must be in (0, 1]"s);
+    }
+
+    std::unique_lock lock(index_mutex_);
+    correction_weight_ = correction_weight;
+    if (max_distance == 0)
+    {
+        fuzzy_index_.reset();
+        return;
+    }
+    if (fuzzy_index_ && fuzzy_index_->GetMaxDistance() == max_distance)
+    {
+        return;
+    }
+    // дальше индекс поддерживается при добавлении и удалении слов словаря
+    fuzzy_index_.emplace(max_distance, index_resource_.get());
+    for (const auto& [word, count] : word_document_counts_)
+    {
+        fuzzy_index_->AddTerm(word);
     }
 }
 
 void SearchServer::RemoveDocument(int document_id)
 {
-    for (auto& [word, freqs] : id_to_word_freqs_.at(document_id))
+    std::unique_lock lock(index_mutex_);
+    const DocIndex doc = id_to_index_.at(document_id);
+    // из сегментов документ не удаляется: он помечается удалённым и выбрасывается при слиянии
+    const auto forget_word = [this](std::string_view word)
     {
-        word_to_document_id_freqs_.at(word).erase(document_id);
-        if (word_to_document_id_freqs_.at(word).empty())
+        const auto count_it = word_document_counts_.find(word);
+        if (--count_it->second == 0)
+        {
+            if (fuzzy_index_)
+            {
+                fuzzy_index_->RemoveTerm(word);
+            }
+            word_document_counts_.erase(count_it);
+        }
+    };
+    if (mode_ == IndexMode::FULL)
+    {
+        for (const auto& [word, freq] : *index_to_word_freqs_[doc])
+        {
+            forget_word(word);
+        }
+        index_to_word_freqs_[doc].reset();
+    }
+    else
+    {
+        ForEachWordOf(doc, [&forget_word](std::string_view word, double)
+        {
+            forget_word(word);
+        });
+    }
+    status_bitmaps_[static_cast<size_t>(statuses_[doc])].Reset(doc);
+    alive_.Reset(doc);
+    index_to_id_[doc] = -1;
+    ++removed_slots_;
+    id_to_index_.erase(document_id);
+    docs_id_.erase(document_id);
+    CompactIfNeeded();
+}
+
+const ImmutableSegment* SearchServer::FindSegment(DocIndex doc) const
+{
+    if (doc >= mutable_segment_.GetFirstDoc())
+    {
+        return nullptr;
+    }
+    // живой документ всегда лежит в каком-то сегменте: пустые сегменты выбрасываются только без живых документов
+    const auto segment_it = std::upper_bound(segments_.begin(), segments_.end(), doc,
+                                             [](DocIndex value, const std::shared_ptr<const ImmutableSegment>& segment)
+    {
+        return value < segment->GetEndDoc();
+    });
+    return segment_it->get();
+}
+
+bool SearchServer::ContainsWord(std::string_view word, DocIndex doc) const
+{
+    if (!term_filter_.MayContain(word))
+    {
+        return false;
+    }
+    const ImmutableSegment* segment = FindSegment(doc);
+    const PostingSpan postings = segment == nullptr ? mutable_segment_.Find(word) : segment->Find(word);
+    return FindPosting(postings, doc) != nullptr;
+}
+
+void SearchServer::CompactIfNeeded()
+{
+    if (removed_slots_ <= docs_id_.size())
+    {
+        return;
+    }
+
+    // нумерация монотонна, поэтому списки документов остаются упорядоченными
+    std::vector<DocIndex> new_index(index_to_id_.size(), 0);
+    DocIndex next = 0;
+    for (DocIndex doc = 0; doc < index_to_id_.size(); ++doc)
+    {
+        if (index_to_id_[doc] >= 0)
+        {
+            new_index[doc] = next++;
+        }
+    }
+
+    // все сегменты сливаются в один с новой нумерацией; идущее фоновое слияние будет отброшено
+    FlushMutableSegment();
+    std::vector<const ImmutableSegment*> parts;
+    for (const auto& segment : segments_)
+    {
+        parts.push_back(segment.get());
+    }
+    auto merged = std::make_shared<const ImmutableSegment>(ImmutableSegment::Merge(parts, alive_, &new_index, index_resource_.get()));
+    segments_.clear();
+    if (merged->GetDocumentCount() != 0)
+    {
+        segments_.push_back(std::move(merged));
+    }
+    mutable_segment_ = MutableSegment(next, mode_ == IndexMode::COMPACT, index_resource_.get());
+    ++compaction_generation_;
+
+    alive_.Clear();
+    for (DocBitmap& bitmap : status_bitmaps_)
+    {
+        bitmap.Clear();
+    }
+    for (DocIndex doc = 0; doc < index_to_id_.size(); ++doc)
+    {
+        if (index_to_id_[doc] < 0)
+        {
+            continue;
+        }
+        const DocIndex target = new_index[doc];
+        if (mode_ == IndexMode::FULL && target != doc) // самоприсваивание перемещением опустошило бы словарь
+        {
+            index_to_word_freqs_[target] = std::move(index_to_word_freqs_[doc]);
+        }
+        index_to_id_[target] = index_to_id_[doc];
+        ratings_[target] = ratings_[doc];
+        statuses_[target] = statuses_[doc];
+        alive_.Set(target);
+        status_bitmaps_[static_cast<size_t>(statuses_[target])].Set(target);
+        id_to_index_[index_to_id_[target]] = target;
+    }
+    index_to_id_.resize(next);
+    ratings_.resize(next);
+    statuses_.resize(next);
+    if (mode_ == IndexMode::FULL)
+    {
+        index_to_word_freqs_.erase(index_to_word_freqs_.begin() + next, index_to_word_freqs_.end());
+    }
+    removed_slots_ = 0;
+    RebuildTermFilter(); // заодно забываем удалённые слова
+}
+
+SearchServer::WordCounts::const_iterator SearchServer::FindWord(std::string_view word) const
+{
+    return term_filter_.MayContain(word) ? word_document_counts_.find(word) : word_document_counts_.end();
+}
+
+void SearchServer::RebuildTermFilter()
+{
+    // запас вдвое, чтобы при росте словаря фильтр перестраивался редко
+    term_filter_ = BlockedBloomFilter(2 * word_document_counts_.size());
+    for (const auto& [word, count] : word_document_counts_)
+    {
+        term_filter_.Add(word);
+    }
+}
+
+void SearchServer::FlushMutableSegment()
+{
+    const DocIndex end_doc = static_cast<DocIndex>(index_to_id_.size());
+    if (end_doc == mutable_segment_.GetFirstDoc())
+    {
+        return;
+    }
+    segments_.push_back(std::make_shared<const ImmutableSegment>(ImmutableSegment::Freeze(mutable_segment_, end_doc, index_resource_.get())));
+    mutable_segment_ = MutableSegment(end_doc, mode_ == IndexMode::COMPACT, index_resource_.get());
+}
+
+void SearchServer::RequestMerge()
+{
+    {
+        std::lock_guard lock(merge_mutex_);
+        merge_pending_ = true;
+    }
+    merge_requested_.notify_one();
+}
+
+void SearchServer::MergeLoop()
+{
+    while (true)
+    {
+        {
+            std::unique_lock lock(merge_mutex_);
+            merge_requested_.wait(lock, [this] { return merge_pending_ || stopping_; });
+            if (stopping_)
+            {
+                return;
+            }
+            merge_pending_ = false;
+        }
+        while (MergeOnce())
+        {
+
+        }
+    }
+}
+
+size_t SearchServer::FindMergeRun() const
+{
+    // ярус сегмента: во сколько раз (по степеням SEGMENT_MERGE_FACTOR) он больше только что замороженного
+    const auto tier = [](size_t document_count)
+    {
+        size_t result = 0;
+        for (size_t limit = SEGMENT_FLUSH_DOCUMENTS * SEGMENT_MERGE_FACTOR; document_count >= limit; limit *= SEGMENT_MERGE_FACTOR)
+        {
+            ++result;
+        }
+        return result;
+    };
+
+    size_t run_start = 0;
+    for (size_t i = 1; i <= segments_.size(); ++i)
+    {
+        if (i - run_start == SEGMENT_MERGE_FACTOR)
+        {
+            return run_start;
+        }
+        if (i < segments_.size() && tier(segments_[i]->GetDocumentCount()) != tier(segments_[run_start]->GetDocumentCount()))
         {
-            word_to_document_id_freqs_.erase(word);
+            run_start = i;
         }
     }
-    id_doc_info_.erase(document_id);
-    id_to_word_freqs_.erase(document_id);
-    for (auto it = docs_id_.begin(); it != docs_id_.end(); ++it)
+    return segments_.size();
+}
+
+bool SearchServer::MergeOnce()
+{
+    std::vector<std::shared_ptr<const ImmutableSegment>> run;
+    DocBitmap alive;
+    uint64_t generation = 0;
     {
-        if (*it == document_id)
+        std::shared_lock lock(index_mutex_);
+        const size_t run_start = FindMergeRun();
+        if (run_start == segments_.size())
         {
-            docs_id_.erase(it);
-            break;
+            return false;
         }
+        run.assign(segments_.begin() + run_start, segments_.begin() + run_start + SEGMENT_MERGE_FACTOR);
+        alive = alive_;
+        generation = compaction_generation_;
+    }
+
+    // сегменты неизменяемы, поэтому сливаются без блокировки;
+    // документы, удалённые после снимка alive, отсекаются при поиске
+    std::vector<const ImmutableSegment*> parts;
+    for (const auto& segment : run)
+    {
+        parts.push_back(segment.get());
+    }
+    auto merged = std::make_shared<const ImmutableSegment>(ImmutableSegment::Merge(parts, alive, nullptr, index_resource_.get()));
+
+    std::unique_lock lock(index_mutex_);
+    if (generation != compaction_generation_)
+    {
+        return true; // документы перенумерованы, результат устарел
     }
+    const auto run_it = std::find(segments_.begin(), segments_.end(), run.front());
+    const auto run_end = segments_.erase(run_it, run_it + run.size());
+    if (merged->GetDocumentCount() != 0)
+    {
+        segments_.insert(run_end, std::move(merged));
+    }
+    return true;
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, DocumentStatus status) const // задан статус
 {
-    return FindTopDocuments(raw_query, [status](int id, DocumentStatus stat, int rating){ return stat == status;});
+    return FindTopDocuments(MatchMode::ANY, raw_query, StatusFilter{status});
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query) const // дефолтный случай
 {
-    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+    return FindTopDocuments(MatchMode::ANY, raw_query, DocumentStatus::ACTUAL);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(MatchMode mode, const std::string& raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(mode, raw_query, StatusFilter{status});
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(MatchMode mode, const std::string& raw_query) const
+{
+    return FindTopDocuments(mode, raw_query, DocumentStatus::ACTUAL);
+}
+
+QueryPlan SearchServer::Explain(const std::string& raw_query) const
+{
+    return Explain(MatchMode::ANY, raw_query);
+}
+
+QueryPlan SearchServer::Explain(MatchMode mode, const std::string& raw_query) const
+{
+    const QueryArena::Scope arena_scope;
+    std::pmr::memory_resource* scratch = arena_scope.GetResource();
+    const Query query_words = ParseQuery(raw_query, scratch);
+    std::shared_lock lock(index_mutex_);
+    const Plan plan = MakePlan(query_words, mode, true, scratch);
+
+    const auto convert = [](const std::pmr::vector<PlanTerm>& terms)
+    {
+        std::vector<PlannedTerm> result;
+        for (const PlanTerm& term : terms)
+        {
+            result.push_back({std::string(term.word), term.document_count, term.weight});
+        }
+        return result;
+    };
+    QueryPlan result;
+    result.strategy = plan.strategy;
+    result.plus_terms = convert(plan.plus_terms);
+    result.dropped_words.assign(plan.dropped_words.begin(), plan.dropped_words.end());
+    for (const std::string_view prefix : plan.dropped_prefixes)
+    {
+        result.dropped_words.push_back(std::string(prefix) + "*"s);
+    }
+    result.excluded_terms = convert(plan.excluded_terms);
+    result.checked_terms = convert(plan.checked_terms);
+    result.estimated_cost = plan.estimated_cost;
+    return result;
 }
 
-void SearchServer::CheckIsValidAndMinuses(const std::string& query_word) const
+SearchServer::Plan SearchServer::MakePlan(const Query& query_words, MatchMode mode, bool pushed_down, std::pmr::memory_resource* resource) const
+{
+    Plan plan(resource);
+
+    // слово, подходящее к нескольким частям запроса, входит в релевантность один раз;
+    // в режиме ALL оно остаётся в каждом требовании ради пересечения, но с нулевым весом
+    std::pmr::set<std::string_view> planned_words(resource);
+    bool requirement_found = false;
+    const auto add_term = [&](std::string_view word, size_t documents_with_word, double weight)
+    {
+        requirement_found = true;
+        const bool first_time = planned_words.insert(word).second;
+        if (first_time || mode == MatchMode::ALL)
+        {
+            plan.plus_terms.push_back({word, documents_with_word, first_time ? ComputeIDF(documents_with_word) * weight : 0.0, plan.requirement_count});
+        }
+    };
+
+    // точные слова раньше раскрытий и исправлений, чтобы совпавшее слово получило полный вес
+    for (const std::string_view plus_word : query_words.plus_words)
+    {
+        const auto count_it = FindWord(plus_word);
+        if (count_it != word_document_counts_.end())
+        {
+            add_term(count_it->first, count_it->second, 1.0);
+            ++plan.requirement_count;
+        }
+    }
+    for (const std::string_view plus_prefix : query_words.plus_prefixes)
+    {
+        requirement_found = false;
+        ForEachWordWithPrefix(plus_prefix, MAX_PREFIX_EXPANSIONS, [&add_term](std::string_view word, size_t documents_with_word)
+        {
+            add_term(word, documents_with_word, 1.0);
+        });
+        if (requirement_found)
+        {
+            ++plan.requirement_count;
+        }
+        else
+        {
+            plan.dropped_prefixes.push_back(plus_prefix);
+        }
+    }
+    for (const std::string_view plus_word : query_words.plus_words)
+    {
+        if (FindWord(plus_word) != word_document_counts_.end())
+        {
+            continue;
+        }
+        requirement_found = false;
+        ForEachCorrection(plus_word, resource, add_term);
+        if (requirement_found)
+        {
+            ++plan.requirement_count;
+        }
+        else
+        {
+            plan.dropped_words.push_back(plus_word);
+        }
+    }
+    plan.unsatisfiable = plan.plus_terms.empty()
+                      || (mode == MatchMode::ALL && !(plan.dropped_words.empty() && plan.dropped_prefixes.empty()));
+    if (plan.unsatisfiable)
+    {
+        plan.strategy = mode == MatchMode::ALL ? QueryStrategy::CONJUNCTIVE : QueryStrategy::EXHAUSTIVE;
+        return plan;
+    }
+    if (mode == MatchMode::ANY)
+    {
+        // stable_sort взял бы буфер из глобальной кучи, поэтому порядок равных задаётся явно
+        std::sort(plan.plus_terms.begin(), plan.plus_terms.end(), [](const PlanTerm& lhs, const PlanTerm& rhs)
+        {
+            return std::tie(lhs.document_count, lhs.requirement, lhs.word) < std::tie(rhs.document_count, rhs.requirement, rhs.word);
+        });
+    }
+
+    std::pmr::vector<PlanTerm> minus_terms(resource);
+    std::pmr::set<std::string_view> minus_words(resource);
+    for (const std::string_view minus_word : query_words.minus_words)
+    {
+        const auto count_it = FindWord(minus_word);
+        if (count_it != word_document_counts_.end() && minus_words.insert(minus_word).second)
+        {
+            minus_terms.push_back({count_it->first, count_it->second, 0.0, 0});
+        }
+    }
+    for (const std::string_view minus_prefix : query_words.minus_prefixes)
+    {
+        ForEachWordWithPrefix(minus_prefix, word_document_counts_.size(), [&](std::string_view word, size_t documents_with_word)
+        {
+            if (minus_words.insert(word).second)
+            {
+                minus_terms.push_back({word, documents_with_word, 0.0, 0});
+            }
+        });
+    }
+
+    // стоимость - примерное число просмотренных записей индекса; поиск галопом стоит логарифм длины списка
+    const auto seek_cost = [](size_t list_size)
+    {
+        return static_cast<size_t>(std::log2(list_size + 1.0)) + 1;
+    };
+    size_t plus_postings = 0;
+    for (const PlanTerm& plus_term : plan.plus_terms)
+    {
+        plus_postings += plus_term.document_count;
+    }
+    size_t minus_postings = 0;
+    size_t selective_postings = 0;
+    size_t unselective_count = 0;
+    for (const PlanTerm& minus_term : minus_terms)
+    {
+        minus_postings += minus_term.document_count;
+        if (minus_term.document_count > MINUS_CHECK_RATIO * plus_postings)
+        {
+            ++unselective_count;
+        }
+        else
+        {
+            selective_postings += minus_term.document_count;
+        }
+    }
+    const size_t document_slots = index_to_id_.size();
+
+    if (mode == MatchMode::ALL || plan.plus_terms.size() == 1)
+    {
+        // для одного слова ANY и ALL совпадают, а пересечение обходится без массива на все документы
+        plan.strategy = QueryStrategy::CONJUNCTIVE;
+        if (mode == MatchMode::ANY)
+        {
+            plan.plus_terms.front().requirement = 0;
+            plan.requirement_count = 1;
+        }
+        std::pmr::vector<size_t> requirement_postings(plan.requirement_count, 0, resource);
+        std::pmr::vector<size_t> requirement_sizes(plan.requirement_count, 0, resource);
+        for (const PlanTerm& plus_term : plan.plus_terms)
+        {
+            requirement_postings[plus_term.requirement] += plus_term.document_count;
+            ++requirement_sizes[plus_term.requirement];
+        }
+        size_t merged_postings = 0;
+        for (size_t i = 0; i < plan.requirement_count; ++i)
+        {
+            merged_postings += requirement_sizes[i] > 1 ? requirement_postings[i] : 0;
+        }
+        const size_t rarest = *std::min_element(requirement_postings.begin(), requirement_postings.end());
+        const size_t largest = *std::max_element(requirement_postings.begin(), requirement_postings.end());
+        plan.estimated_cost = merged_postings + rarest * (1 + (plan.requirement_count - 1 + minus_terms.size()) * seek_cost(largest));
+        plan.excluded_terms = std::move(minus_terms); // минус-слова отсекаются прямо при пересечении
+        return plan;
+    }
+
+    // плотный массив не просматривается целиком, но тронутые документы сортируются перед сбором
+    const size_t touched_documents = plus_postings + selective_postings;
+    const size_t exhaustive_cost = plus_postings + selective_postings + touched_documents * seek_cost(touched_documents)
+                                 + plus_postings * unselective_count * seek_cost(document_slots);
+    plan.strategy = QueryStrategy::EXHAUSTIVE;
+    plan.estimated_cost = exhaustive_cost;
+    // слияние платит кучей за каждую запись плюс-слов, а минус-слова догоняют документы галопом
+    size_t sparse_cost = plus_postings * seek_cost(plan.plus_terms.size());
+    for (const PlanTerm& minus_term : minus_terms)
+    {
+        sparse_cost += plus_postings * seek_cost(minus_term.document_count / (plus_postings + 1));
+    }
+    if (sparse_cost < plan.estimated_cost)
+    {
+        plan.strategy = QueryStrategy::SPARSE;
+        plan.estimated_cost = sparse_cost;
+    }
+    // отсечение может включиться перед словом split, только если более редкие слова весят больше оставшихся
+    double total_weight = 0.0;
+    for (const PlanTerm& plus_term : plan.plus_terms)
+    {
+        total_weight += plus_term.weight;
+    }
+    double rare_weight = 0.0;
+    size_t rare_postings = 0;
+    size_t split = 0;
+    for (; split < plan.plus_terms.size() && rare_weight <= total_weight - rare_weight; ++split)
+    {
+        rare_weight += plan.plus_terms[split].weight;
+        rare_postings += plan.plus_terms[split].document_count;
+    }
+    if (pushed_down && split < plan.plus_terms.size()) // иначе порог топа нельзя считать до проверки предиката
+    {
+        size_t pruned_cost = rare_postings + minus_postings + rare_postings * seek_cost(rare_postings);
+        for (size_t i = split; i < plan.plus_terms.size(); ++i)
+        {
+            pruned_cost += rare_postings * seek_cost(plan.plus_terms[i].document_count);
+        }
+        if (pruned_cost < plan.estimated_cost)
+        {
+            // порог считается по окончательно отобранным документам, поэтому все минус-слова исключаются заранее
+            plan.strategy = QueryStrategy::PRUNED;
+            plan.estimated_cost = pruned_cost;
+            plan.excluded_terms = std::move(minus_terms);
+            return plan;
+        }
+    }
+    if (plan.strategy == QueryStrategy::SPARSE)
+    {
+        plan.excluded_terms = std::move(minus_terms); // минус-слова отсекаются прямо при слиянии
+        return plan;
+    }
+    for (const PlanTerm& minus_term : minus_terms)
+    {
+        (minus_term.document_count > MINUS_CHECK_RATIO * plus_postings ? plan.checked_terms : plan.excluded_terms).push_back(minus_term);
+    }
+    return plan;
+}
+
+void SearchServer::CheckIsValidAndMinuses(std::string_view query_word) const
 {
     if (DetectTwoMinus(query_word))
     {
@@ -86,19 +745,19 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings)
     return average_rating;
 }
 
-bool SearchServer::IsStopWord(const std::string& word) const
+bool SearchServer::IsStopWord(std::string_view word) const
 {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
-std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string& text) const
+std::pmr::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text, std::pmr::memory_resource* resource) const
 {
-    std::vector<std::string> words;
-    for (const std::string& word : SplitIntoWords(text))
+    std::pmr::vector<std::string_view> words(resource);
+    for (const std::string_view word : SplitIntoWordsView(text, resource))
     {
         if (!IsValidWord(word))
         {
-            const std::string hint = "Invalid word: "s + word;
+            const std::string hint = "Invalid word: "s + std::string(word);
             throw std::invalid_argument(hint);
         }
 
@@ -110,59 +769,76 @@ std::vector<std::string> SearchServer::SplitIntoWordsNoStop(const std::string& t
     return words;
 }
 
-SearchServer::Query SearchServer::ParseQueryWord(const std::string& word) const
+void SearchServer::ParseQueryWord(std::string_view word, Query& query_words) const
 {
-    Query query_words;
     CheckIsValidAndMinuses(word);
 
-    if (word[0] == '-') // минус-слово
+    const bool is_minus = word[0] == '-';
+    if (is_minus)
+    {
+        word.remove_prefix(1);
+    }
+    const bool is_prefix = word.back() == '*';
+    if (is_prefix)
     {
-        std::string no_minus = word.substr(1);
-        if (!IsStopWord(no_minus))
+        word.remove_suffix(1);
+        if (word.empty())
+        {
+            throw std::invalid_argument("No prefix before asterisk"s);
+        }
+    }
+
+    if (is_minus) // минус-слово
+    {
+        if (is_prefix)
+        {
+            query_words.minus_prefixes.insert(word);
+        }
+        else if (!IsStopWord(word))
         {
-            query_words.minus_words.insert(no_minus);
+            query_words.minus_words.insert(word);
         }
     }
     else // плюс-слово
     {
-        query_words.plus_words.insert(word);
+        if (is_prefix)
+        {
+            query_words.plus_prefixes.insert(word);
+        }
+        else
+        {
+            query_words.plus_words.insert(word);
+        }
     }
-    return query_words;
 }
 
-bool SearchServer::DetectTwoMinus(const std::string& query_word)
+bool SearchServer::DetectTwoMinus(std::string_view query_word)
 {
     return query_word.substr(0, 2) == "--";
 }
 
-bool SearchServer::DetectNoWordAfterMinus(const std::string& query_word)
+bool SearchServer::DetectNoWordAfterMinus(std::string_view query_word)
 {
     return query_word == "-";
 }
 
-bool SearchServer::IsValidWord(const std::string& query_word)
+bool SearchServer::IsValidWord(std::string_view query_word)
 {
-    return none_of(query_word.begin(), query_word.end(), [](char c)
+    return std::none_of(query_word.begin(), query_word.end(), [](char c)
     {
         return c >= '\0' && c < ' ';
     });
 }
-void SearchServer::Query::insert(Query query_words)
+SearchServer::Query SearchServer::ParseQuery(std::string_view text, std::pmr::memory_resource* resource) const
 {
-    minus_words.merge(query_words.minus_words);
-    plus_words.merge(query_words.plus_words);
-}
-
-SearchServer::Query SearchServer::ParseQuery(const std::string& text) const
-{
-    Query query_words;
-    for (const std::string& word : SplitIntoWordsNoStop(text))
+    Query query_words(resource);
+    for (const std::string_view word : SplitIntoWordsNoStop(text, resource))
     {
-        query_words.insert(ParseQueryWord(word));
+        ParseQueryWord(word, query_words);
     }
 
     // если минус-слово и плюс-слово одинаковы -> убираем плюс-слово
-    for (const std::string& minus_word : query_words.minus_words)
+    for (const std::string_view minus_word : query_words.minus_words)
     {
         if (query_words.plus_words.count(minus_word) != 0)
         {
@@ -172,38 +848,70 @@ SearchServer::Query SearchServer::ParseQuery(const std::string& text) const
     return query_words;
 }
 
-double SearchServer::ComputeIDF(const std::string& plus_word) const
+double SearchServer::ComputeIDF(size_t documents_with_word) const
 {
-    return log(docs_id_.size() * 1.0 / word_to_document_id_freqs_.at(plus_word).size());
+    return log(docs_id_.size() * 1.0 / documents_with_word);
 }
 
 std::tuple<std::vector<std::string>, DocumentStatus> SearchServer::MatchDocument(const std::string& raw_query, int document_id) const
 {
     std::vector<std::string> plus_words;
-    Query query_words = ParseQuery(raw_query);
+    const QueryArena::Scope arena_scope;
+    std::pmr::memory_resource* scratch = arena_scope.GetResource();
+    const Query query_words = ParseQuery(raw_query, scratch);
+    std::shared_lock lock(index_mutex_);
+    const DocIndex doc = id_to_index_.at(document_id);
 
-    for (const std::string& minus_word : query_words.minus_words)
+    for (const std::string_view minus_word : query_words.minus_words)
     {
-        if (word_to_document_id_freqs_.find(minus_word) != word_to_document_id_freqs_.end())
+        if (ContainsWord(minus_word, doc))
         {
-            if (word_to_document_id_freqs_.at(minus_word).find(document_id) != word_to_document_id_freqs_.at(minus_word).end())
-            {
-                return {std::vector<std::string> {}, id_doc_info_.at(document_id).status};
-            }
+            return {std::vector<std::string> {}, statuses_[doc]};
         }
     }
+    bool excluded = false;
+    for (const std::string_view minus_prefix : query_words.minus_prefixes)
+    {
+        ForEachWordWithPrefix(minus_prefix, word_document_counts_.size(), [&](std::string_view word, size_t)
+        {
+            excluded = excluded || ContainsWord(word, doc);
+        });
+    }
+    if (excluded)
+    {
+        return {std::vector<std::string> {}, statuses_[doc]};
+    }
 
-    for (const std::string& plus_word : query_words.plus_words)
+    std::set<std::string_view> matched_words;
+    for (const std::string_view plus_word : query_words.plus_words)
     {
-        if (word_to_document_id_freqs_.find(plus_word) != word_to_document_id_freqs_.end())
+        if (ContainsWord(plus_word, doc))
+        {
+            matched_words.insert(plus_word);
+        }
+        else if (FindWord(plus_word) == word_document_counts_.end()) // слова нет в словаре: проверяем его исправления
         {
-            if (word_to_document_id_freqs_.at(plus_word).find(document_id) != word_to_document_id_freqs_.at(plus_word).end())
+            ForEachCorrection(plus_word, scratch, [&](std::string_view word, size_t, double)
             {
-                plus_words.push_back(plus_word);
-            }
+                if (ContainsWord(word, doc))
+                {
+                    matched_words.insert(word);
+                }
+            });
         }
     }
-    return {plus_words, id_doc_info_.at(document_id).status};
+    for (const std::string_view plus_prefix : query_words.plus_prefixes) // раскрытия те же, что и при поиске
+    {
+        ForEachWordWithPrefix(plus_prefix, MAX_PREFIX_EXPANSIONS, [&](std::string_view word, size_t)
+        {
+            if (ContainsWord(word, doc))
+            {
+                matched_words.insert(word);
+            }
+        });
+    }
+    plus_words.assign(matched_words.begin(), matched_words.end());
+    return {plus_words, statuses_[doc]};
 }
 
 void SearchServer::AddDocument(const int document_id, const std::string& document, const DocumentStatus& stat, const std::vector<int>& ratings)
@@ -213,24 +921,71 @@ void SearchServer::AddDocument(const int document_id, const std::string& documen
         throw std::invalid_argument("Id is less than 0"s);
     }
 
-    if (id_doc_info_.find(document_id) != id_doc_info_.end())
+    const QueryArena::Scope arena_scope;
+    const std::pmr::vector<std::string_view> words = SplitIntoWordsNoStop(document, arena_scope.GetResource());
+
+    std::unique_lock lock(index_mutex_);
+    if (id_to_index_.find(document_id) != id_to_index_.end())
     {
         throw std::invalid_argument("Document with such an id already exists"s);
     }
 
+    // новый документ всегда получает следующий номер, поэтому списки остаются упорядоченными
+    const DocIndex doc = static_cast<DocIndex>(index_to_id_.size());
     docs_id_.insert(document_id);
-
-    std::vector<std::string> words = SplitIntoWordsNoStop(document);
+    id_to_index_.emplace(document_id, doc);
+    index_to_id_.push_back(document_id);
+    alive_.Set(doc);
 
     int averageRating = ComputeAverageRating(ratings);
-    id_doc_info_[document_id].rating = averageRating;
+    ratings_.push_back(averageRating);
+    statuses_.push_back(stat);
+    status_bitmaps_[static_cast<size_t>(stat)].Set(doc);
 
-    id_doc_info_[document_id].status = stat;
+    WordFrequencies* word_freqs = nullptr;
+    if (mode_ == IndexMode::FULL)
+    {
+        std::pmr::polymorphic_allocator<WordFrequencies> allocator(index_resource_.get());
+        word_freqs = allocator.allocate(1);
+        allocator.construct(word_freqs); // узлы словаря получают тот же пул
+        index_to_word_freqs_.push_back(WordFrequenciesPtr(word_freqs, PoolDelete{index_resource_.get()}));
+    }
+    for (const std::string_view word : words)
+    {
+        // аккумулируем TF для всех слов; ключи копируются в пул индекса
+        if (mutable_segment_.AddPosting(word, doc, 1.0 / words.size())) // первое вхождение слова в документ
+        {
+            auto count_it = word_document_counts_.find(word);
+            if (count_it == word_document_counts_.end())
+            {
+                count_it = word_document_counts_.try_emplace(std::pmr::string(word, index_resource_.get()), 0).first;
+                term_filter_.Add(word);
+                if (word_document_counts_.size() > term_filter_.GetCapacity())
+                {
+                    RebuildTermFilter();
+                }
+                if (fuzzy_index_)
+                {
+                    fuzzy_index_->AddTerm(word);
+                }
+            }
+            ++count_it->second;
+        }
+
+        if (word_freqs != nullptr)
+        {
+            auto freq_it = word_freqs->find(word);
+            if (freq_it == word_freqs->end())
+            {
+                freq_it = word_freqs->try_emplace(std::pmr::string(word, index_resource_.get())).first;
+            }
+            freq_it->second += 1.0 / words.size();
+        }
+    }
 
-    for (const std::string& word : words)
+    if (index_to_id_.size() - mutable_segment_.GetFirstDoc() >= SEGMENT_FLUSH_DOCUMENTS)
     {
-        // аккумулируем TF для всех слов
-        word_to_document_id_freqs_[word][document_id] += 1.0 / words.size();
-        id_to_word_freqs_[document_id][word] += 1.0 / words.size();
+        FlushMutableSegment();
+        RequestMerge();
     }
 }
@@ -1,36 +1,116 @@
 #pragma once
 #include <algorithm>
+#include <array>
+#include <functional>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <map>
 #include <numeric>
 #include <stdexcept>
 #include <cmath>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include "string_processing.h"
+#include "blocked_bloom_filter.h"
 #include "document.h"
+#include "document_filters.h"
+#include "deletion_index.h"
+#include "doc_bitmap.h"
+#include "index_segment.h"
+#include "memory_stats.h"
+#include "query_arena.h"
+#include "query_plan.h"
+#include "stop_words.h"
 //#include "log_duration.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
+const size_t SEGMENT_FLUSH_DOCUMENTS = 1024; // размер изменяемого сегмента, после которого он замораживается
+const size_t SEGMENT_MERGE_FACTOR = 4;       // столько сегментов одного яруса сливаются в один
+const size_t MAX_PREFIX_EXPANSIONS = 64;     // сколько слов словаря подставляется вместо одного плюс-префикса
+const size_t MAX_FUZZY_DISTANCE = 2;
+const size_t MINUS_CHECK_RATIO = 8; // минус-слово с таким во столько раз более длинным списком, чем у плюс-слов, проверяется только у найденных документов
+
+enum struct MatchMode
+{
+    ANY, // документ содержит хотя бы одно плюс-слово
+    ALL  // документ содержит все плюс-слова; для префикса или исправленного слова - хотя бы один из вариантов
+};
+
+enum struct IndexMode
+{
+    FULL,    // хранится и прямой индекс документ -> слова
+    COMPACT  // прямого индекса нет; сегмент хранит для документа сжатые номера его слов в своём словаре
+};
 
 class SearchServer
 {
 public:
+    using WordFrequencies = std::pmr::map<std::pmr::string, double, std::less<>>;
+
+    // все структуры индекса выделяются из пула поверх upstream
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
+    SearchServer(const StringContainer& stop_words, IndexMode mode,
+                 std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    template <typename StringContainer>
+    explicit SearchServer(const StringContainer& stop_words,
+                          std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : SearchServer(stop_words, IndexMode::FULL, upstream)
+    {
+
+    }
+
+    SearchServer(const std::string& stop_words_text, IndexMode mode,
+                 std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : SearchServer(SplitIntoWords(stop_words_text), mode, upstream)
+    {
 
-    explicit SearchServer(const std::string& stop_words_text)
-        : SearchServer(SplitIntoWords(stop_words_text))
+    }
+
+    explicit SearchServer(const std::string& stop_words_text,
+                          std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : SearchServer(SplitIntoWords(stop_words_text), IndexMode::FULL, upstream)
     {
 
     }
 
+    // совершенная хеш-таблица стоп-слов уже построена при компиляции
+    template <size_t N>
+    explicit SearchServer(const StaticStopWords<N>& stop_words, IndexMode mode = IndexMode::FULL,
+                          std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : SearchServer(StopWordSet(stop_words), mode, upstream)
+    {
+
+    }
+
+    SearchServer(const SearchServer&) = delete;
+    SearchServer& operator=(const SearchServer&) = delete;
+    ~SearchServer();
+
     int GetDocumentCount() const;
 
-    const std::set<int>::iterator begin();
-    const std::set<int>::iterator end();
+    const std::pmr::set<int>::iterator begin();
+    const std::pmr::set<int>::iterator end();
 
-    const std::map<std::string, double>& GetWordFrequencies(int document_id) const;
+    // в режиме FULL ссылка действительна до удаления документа;
+    // в режиме COMPACT словарь собирается из сегмента документа,
+    // и ссылка действительна до следующего вызова в том же потоке
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
+
+    MemoryStats GetMemoryStats() const;
+
+    // Плюс-слово, которого нет в словаре, заменяется ближайшими словами на расстоянии правки
+    // от 1 до max_distance; их вклад умножается на correction_weight за каждую правку.
+    // max_distance = 0 выключает нечёткий поиск.
+    void SetFuzzyMatching(size_t max_distance, double correction_weight = 0.5);
 
     void RemoveDocument(int document_id);
 
@@ -43,129 +123,717 @@ public:
     std::vector<Document> FindTopDocuments(const std::string& raw_query, DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(const std::string& raw_query) const;
 
+    // предикат вызывается после снятия блокировки индекса, поэтому может сам обращаться к серверу
+    template <typename T>
+    std::vector<Document> FindTopDocuments(MatchMode mode, const std::string& raw_query, T predicate) const;
+    std::vector<Document> FindTopDocuments(MatchMode mode, const std::string& raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(MatchMode mode, const std::string& raw_query) const;
+
+    // план, который выбрал бы FindTopDocuments с фильтром по статусу
+    QueryPlan Explain(const std::string& raw_query) const;
+    QueryPlan Explain(MatchMode mode, const std::string& raw_query) const;
+
 private:
-    struct DocumentInfo
+    using WordCounts = std::pmr::map<std::pmr::string, uint32_t, std::less<>>;
+
+    // возвращает словарь документа в пул, из которого он выделен
+    struct PoolDelete
     {
-        int rating;
-        DocumentStatus status;
+        std::pmr::memory_resource* resource = nullptr;
+
+        void operator()(WordFrequencies* word_freqs) const;
     };
+    using WordFrequenciesPtr = std::unique_ptr<WordFrequencies, PoolDelete>;
+
+    SearchServer(StopWordSet stop_words, IndexMode mode, std::pmr::memory_resource* upstream);
 
+    // слова запроса ссылаются на строку запроса, память берётся из арены запроса;
+    // префиксы записываются как "pet*" и хранятся без звёздочки
     struct Query
     {
-        std::set<std::string> minus_words;
-        std::set<std::string> plus_words;
-        void insert(Query query_words);
+        explicit Query(std::pmr::memory_resource* resource)
+            : minus_words(resource), plus_words(resource), minus_prefixes(resource), plus_prefixes(resource)
+        {
+
+        }
+
+        std::pmr::set<std::string_view> minus_words;
+        std::pmr::set<std::string_view> plus_words;
+        std::pmr::set<std::string_view> minus_prefixes;
+        std::pmr::set<std::string_view> plus_prefixes;
+    };
+
+    struct PlanTerm
+    {
+        std::string_view word; // ссылается на ключ word_document_counts_, план живёт под блокировкой
+        size_t document_count;
+        double weight;
+        size_t requirement;    // номер плюс-слова или префикса запроса, которому слово удовлетворяет
+    };
+
+    struct Plan
+    {
+        explicit Plan(std::pmr::memory_resource* resource)
+            : plus_terms(resource), dropped_words(resource), dropped_prefixes(resource), excluded_terms(resource), checked_terms(resource)
+        {
+
+        }
+
+        QueryStrategy strategy = QueryStrategy::EXHAUSTIVE;
+        std::pmr::vector<PlanTerm> plus_terms; // от редких к частым
+        std::pmr::vector<std::string_view> dropped_words;
+        std::pmr::vector<std::string_view> dropped_prefixes;
+        std::pmr::vector<PlanTerm> excluded_terms;
+        std::pmr::vector<PlanTerm> checked_terms;
+        size_t requirement_count = 0;
+        bool unsatisfiable = false; // заранее известно, что документов не будет
+        size_t estimated_cost = 0;
     };
 
-    std::set<int> docs_id_;
-    std::unordered_map<int, DocumentInfo> id_doc_info_;
-    std::map<std::string, std::map<int, double>> word_to_document_id_freqs_;
-    std::map<int, std::map<std::string, double>> id_to_word_freqs_;
+    // найденный документ; статус нужен предикату, который проверяется уже без блокировки
+    struct Match
+    {
+        Document document;
+        DocumentStatus status;
+    };
 
-    const std::set<std::string> stop_words_;
-    template<typename Collection>
-    void SetStopWords(const Collection& collection);
+    // Плотные массивы по DocIndex для стратегий EXHAUSTIVE и PRUNED, свои у каждого потока.
+    // Между запросами массивы обнулены: запрос запоминает документы, которых коснулся,
+    // и сбрасывает только их, поэтому его цена не зависит от числа документов в индексе.
+    class DocumentScratch
+    {
+    public:
+        enum : uint8_t { UNSEEN, MATCHED, EXCLUDED };
 
-    static bool IsValidWord(const std::string& query_word);
-    bool IsStopWord(const std::string& word) const;
+        // массивы потока дорастают до document_slots
+        explicit DocumentScratch(size_t document_slots);
+        ~DocumentScratch();
 
-    std::vector<std::string> SplitIntoWordsNoStop(const std::string& text) const;
+        DocumentScratch(const DocumentScratch&) = delete;
+        DocumentScratch& operator=(const DocumentScratch&) = delete;
 
-    static bool DetectTwoMinus(const std::string& query_word);
-    static bool DetectNoWordAfterMinus(const std::string& query_word);
-    void CheckIsValidAndMinuses(const std::string& query_word) const;
+        inline uint8_t GetState(DocIndex doc) const
+        {
+            return arrays_.state[doc];
+        }
 
-    Query ParseQuery(const std::string& text) const;
-    Query ParseQueryWord(const std::string& word) const;
+        inline void SetState(DocIndex doc, uint8_t state)
+        {
+            if (arrays_.state[doc] == UNSEEN)
+            {
+                arrays_.touched.push_back(doc);
+            }
+            arrays_.state[doc] = state;
+        }
+
+        inline double& Relevance(DocIndex doc)
+        {
+            return arrays_.relevance[doc];
+        }
+
+        // тронутые документы по возрастанию
+        const std::vector<DocIndex>& SortTouched();
+
+    private:
+        struct Arrays
+        {
+            std::vector<double> relevance;
+            std::vector<uint8_t> state;
+            std::vector<DocIndex> touched;
+        };
+
+        Arrays& arrays_;
+    };
+
+    // пул общий с фоновым слиянием сегментов, поэтому синхронизированный
+    std::unique_ptr<std::pmr::synchronized_pool_resource> index_resource_;
+    const IndexMode mode_;
+
+    // запросы берут разделяемую блокировку, изменения индекса - исключительную
+    mutable std::shared_mutex index_mutex_;
+
+    // внешние id встречаются только здесь; всё остальное индексируется DocIndex
+    std::pmr::set<int> docs_id_;
+    std::pmr::unordered_map<int, DocIndex> id_to_index_;
+    std::pmr::vector<int> index_to_id_; // -1 для удалённых документов до уплотнения
+    DocBitmap alive_; // удалённые документы остаются в сегментах до слияния
+
+    // метаданные хранятся по столбцам, плюс битовая карта документов на каждый статус
+    std::pmr::vector<int> ratings_;
+    std::pmr::vector<DocumentStatus> statuses_;
+    std::array<DocBitmap, DOCUMENT_STATUS_COUNT> status_bitmaps_;
+    // словари лежат отдельно, чтобы ссылки на них переживали рост вектора и перенумерацию,
+    // но, как и их узлы, в пуле индекса; пуст в режиме COMPACT
+    std::pmr::vector<WordFrequenciesPtr> index_to_word_freqs_;
+    size_t removed_slots_ = 0;
+
+    // сегменты индекса: неизменяемые по возрастанию документов, затем изменяемый
+    WordCounts word_document_counts_; // по живым документам, для IDF
+    BlockedBloomFilter term_filter_;  // все слова словаря и, до перестройки, удалённые из него
+    std::optional<DeletionIndex> fuzzy_index_; // обновляется вместе со словарём word_document_counts_
+    double correction_weight_ = 1.0;
+    std::vector<std::shared_ptr<const ImmutableSegment>> segments_;
+    MutableSegment mutable_segment_;
+    uint64_t compaction_generation_ = 0;
+
+    std::mutex merge_mutex_;
+    std::condition_variable merge_requested_;
+    bool merge_pending_ = false;
+    bool stopping_ = false;
+    std::thread merge_thread_;
+
+    const StopWordSet stop_words_;
+
+    static bool IsValidWord(std::string_view query_word);
+    bool IsStopWord(std::string_view word) const;
+
+    std::pmr::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text, std::pmr::memory_resource* resource) const;
+
+    static bool DetectTwoMinus(std::string_view query_word);
+    static bool DetectNoWordAfterMinus(std::string_view query_word);
+    void CheckIsValidAndMinuses(std::string_view query_word) const;
+
+    Query ParseQuery(std::string_view text, std::pmr::memory_resource* resource) const;
+    void ParseQueryWord(std::string_view word, Query& query_words) const;
+
+    // фильтр Блума отвечает на большинство вопросов об отсутствующих словах без спуска по дереву
+    WordCounts::const_iterator FindWord(std::string_view word) const;
+    void RebuildTermFilter();
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
-    double ComputeIDF(const std::string& plus_word) const;
+    double ComputeIDF(size_t documents_with_word) const;
+
+    // callback(segment) для неизменяемых сегментов по возрастанию документов, затем для изменяемого
+    template <typename Callback>
+    void ForEachSegment(Callback callback) const;
+    template <typename Callback>
+    void ForEachPosting(std::string_view word, Callback callback) const;
+    // неизменяемый сегмент живого документа, nullptr - документ в изменяемом сегменте
+    const ImmutableSegment* FindSegment(DocIndex doc) const;
+    bool ContainsWord(std::string_view word, DocIndex doc) const;
+    // callback(word, documents_with_word) для слов словаря с данным префиксом по алфавиту, не больше limit
+    template <typename Callback>
+    void ForEachWordWithPrefix(std::string_view prefix, size_t limit, Callback callback) const;
+    // callback(word, documents_with_word, weight) для исправлений слова, которого нет в словаре
+    template <typename Callback>
+    void ForEachCorrection(std::string_view word, std::pmr::memory_resource* scratch, Callback callback) const;
+    // callback(word, tf) для слов документа по номерам слов, которые хранит его сегмент (режим COMPACT)
+    template <typename Callback>
+    void ForEachWordOf(DocIndex doc, Callback callback) const;
+
+    // перенумеровывает живые документы подряд, когда дырок становится больше, чем документов
+    void CompactIfNeeded();
+
+    void FlushMutableSegment();
+    void RequestMerge();
+    void MergeLoop();
+    // сливает один ярус сегментов, возвращает false, если сливать нечего
+    bool MergeOnce();
+    size_t FindMergeRun() const;
 
     template <typename T>
-    std::vector<Document> FindAllDocuments(const Query& query_words, T predicate) const;
+    static constexpr bool IS_PUSHED_DOWN = std::is_same_v<T, StatusFilter> || std::is_same_v<T, RatingRange>;
+
+    // для распознанных предикатов отсекает документ до подсчёта релевантности
+    template <typename T>
+    bool PassesPushdown(const T& predicate, DocIndex doc) const;
+
+    // вызывается под разделяемой блокировкой; pushed_down - предикат проверяется до подсчёта релевантности
+    Plan MakePlan(const Query& query_words, MatchMode mode, bool pushed_down, std::pmr::memory_resource* resource) const;
+
+    // стратегии EXHAUSTIVE и PRUNED; вызываются под разделяемой блокировкой и проверяют только предикаты pushdown
+    template <typename T>
+    std::pmr::vector<Match> FindAllDocuments(const Plan& plan, T predicate, std::pmr::memory_resource* resource) const;
+    // стратегия SPARSE: слияние списков документов внутри каждого сегмента через кучу курсоров
+    template <typename T>
+    std::pmr::vector<Match> FindAllDocumentsSparse(const Plan& plan, T predicate, std::pmr::memory_resource* resource) const;
+    // стратегия CONJUNCTIVE: пересечение списков документов внутри каждого сегмента, начиная с самого короткого
+    template <typename T>
+    std::pmr::vector<Match> FindAllDocumentsConjunctive(const Plan& plan, T predicate, std::pmr::memory_resource* resource) const;
 
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+SearchServer::SearchServer(const StringContainer& stop_words, IndexMode mode, std::pmr::memory_resource* upstream)
+    : SearchServer(StopWordSet(MakeUniqueNonEmptyStrings(stop_words)), mode, upstream)
 {
-    using namespace std::literals;
-    if (any_of(stop_words_.begin(), stop_words_.end(), [](const std::string& word) {return !IsValidWord(word);}))
-    {
-        throw std::invalid_argument("Word contains symbols with codes from 0 to 31"s);
-    }
+
 }
 
 template <typename T>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string& raw_query, T predicate) const // задано условие
 {
-    const Query query_words = ParseQuery(raw_query); // проверку на минусы и валидность закинул в ParseQueryWord
-    std::vector<Document> matched_documents = FindAllDocuments(query_words, predicate);
+    return FindTopDocuments(MatchMode::ANY, raw_query, predicate);
+}
+
+template <typename T>
+std::vector<Document> SearchServer::FindTopDocuments(MatchMode mode, const std::string& raw_query, T predicate) const
+{
+    const QueryArena::Scope arena_scope; // вложенный поиск из предиката не освободит память этого запроса
+    std::pmr::memory_resource* scratch = arena_scope.GetResource();
+    const Query query_words = ParseQuery(raw_query, scratch); // проверку на минусы и валидность закинул в ParseQueryWord
+    std::shared_lock lock(index_mutex_);
+    const Plan plan = MakePlan(query_words, mode, IS_PUSHED_DOWN<T>, scratch);
+    std::pmr::vector<Match> matched_documents = plan.strategy == QueryStrategy::CONJUNCTIVE
+                                              ? FindAllDocumentsConjunctive(plan, predicate, scratch)
+                                              : plan.strategy == QueryStrategy::SPARSE
+                                              ? FindAllDocumentsSparse(plan, predicate, scratch)
+                                              : FindAllDocuments(plan, predicate, scratch);
+    lock.unlock();
+
+    if constexpr (!IS_PUSHED_DOWN<T>)
+    {
+        matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(),
+                                               [&predicate](const Match& match)
+        {
+            return !predicate(match.document.id, match.status, match.document.rating); // предикат возвращает булево значение
+        }), matched_documents.end());
+    }
 
     sort(matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs)
+         [](const Match& lhs, const Match& rhs)
     {
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON)
-             return lhs.rating > rhs.rating;
+        if (std::abs(lhs.document.relevance - rhs.document.relevance) < EPSILON)
+             return lhs.document.rating > rhs.document.rating;
         else
         {
-            return lhs.relevance > rhs.relevance;
+            return lhs.document.relevance > rhs.document.relevance;
         }
     });
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+    // в кучу уходит только итоговый результат
+    const size_t result_size = std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::vector<Document> result;
+    result.reserve(result_size);
+    for (size_t i = 0; i < result_size; ++i)
     {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        result.push_back(matched_documents[i].document);
     }
+    return result;
+}
 
-    return matched_documents;
+template <typename Callback>
+void SearchServer::ForEachSegment(Callback callback) const
+{
+    for (const auto& segment : segments_)
+    {
+        callback(*segment);
+    }
+    callback(mutable_segment_);
+}
+
+template <typename Callback>
+void SearchServer::ForEachPosting(std::string_view word, Callback callback) const
+{
+    ForEachSegment([word, &callback](const auto& segment)
+    {
+        for (const Posting& posting : segment.Find(word))
+        {
+            callback(posting);
+        }
+    });
+}
+
+template <typename Callback>
+void SearchServer::ForEachWordWithPrefix(std::string_view prefix, size_t limit, Callback callback) const
+{
+    size_t expanded = 0;
+    for (auto word_it = word_document_counts_.lower_bound(prefix);
+         word_it != word_document_counts_.end() && expanded < limit && std::string_view(word_it->first).substr(0, prefix.size()) == prefix;
+         ++word_it, ++expanded)
+    {
+        callback(std::string_view(word_it->first), word_it->second);
+    }
+}
+
+template <typename Callback>
+void SearchServer::ForEachCorrection(std::string_view word, std::pmr::memory_resource* scratch, Callback callback) const
+{
+    if (!fuzzy_index_)
+    {
+        return;
+    }
+    fuzzy_index_->ForEachCorrection(word, scratch, [&](std::string_view correction, size_t distance)
+    {
+        callback(correction, word_document_counts_.find(correction)->second, std::pow(correction_weight_, distance));
+    });
+}
+
+template <typename Callback>
+void SearchServer::ForEachWordOf(DocIndex doc, Callback callback) const
+{
+    const ImmutableSegment* segment = FindSegment(doc);
+    if (segment == nullptr)
+    {
+        mutable_segment_.ForEachWordOf(doc, callback);
+    }
+    else
+    {
+        segment->ForEachWordOf(doc, callback);
+    }
 }
 
-template<typename Collection>
-void SearchServer::SetStopWords(const Collection& collection)
+template <typename T>
+bool SearchServer::PassesPushdown(const T& predicate, DocIndex doc) const
 {
-    for (const auto& word : collection)
+    if constexpr (std::is_same_v<T, StatusFilter>)
+    {
+        return status_bitmaps_[static_cast<size_t>(predicate.status)].Test(doc);
+    }
+    else if constexpr (std::is_same_v<T, RatingRange>)
     {
-        stop_words_.insert(word);
+        return ratings_[doc] >= predicate.min_rating && ratings_[doc] <= predicate.max_rating;
+    }
+    else
+    {
+        return true;
     }
 }
 
 template <typename T>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query_words, T predicate) const
+std::pmr::vector<SearchServer::Match> SearchServer::FindAllDocuments(const Plan& plan, T predicate, std::pmr::memory_resource* resource) const
 {
-    std::map<int, double> document_to_relevance;
-    std::vector<Document> matched_documents;
+    std::pmr::vector<Match> matched_documents(resource);
+    if (plan.unsatisfiable)
+    {
+        return matched_documents;
+    }
+    DocumentScratch dense(index_to_id_.size());
+
+    for (const PlanTerm& minus_term : plan.excluded_terms) // сначала исключаем документы с избирательными минус-словами
+    {
+        ForEachPosting(minus_term.word, [&dense](const Posting& posting)
+        {
+            dense.SetState(posting.doc, DocumentScratch::EXCLUDED);
+        });
+    }
+
+    // PRUNED: TF не больше 1, поэтому непросмотренные слова добавят новому документу не больше суммы своих весов.
+    // Когда эта сумма ниже порога текущего топа, оставшиеся слова досчитываются только у уже найденных документов.
+    const bool prunable = plan.strategy == QueryStrategy::PRUNED;
+    bool pruning = false;
+    std::pmr::vector<DocIndex> candidates(resource);
+    double remaining_bound = 0.0;
+    for (const PlanTerm& plus_term : plan.plus_terms)
+    {
+        remaining_bound += plus_term.weight;
+    }
 
-    for (const std::string& plus_word : query_words.plus_words) // итерируем по плюс-словам
+    for (const PlanTerm& plus_term : plan.plus_terms) // от редких слов к частым
     {
-        if (word_to_document_id_freqs_.find(plus_word) != word_to_document_id_freqs_.end()) // нашли плюс-слово
+        remaining_bound -= plus_term.weight;
+        if (pruning)
         {
-            double IDF = SearchServer::ComputeIDF(plus_word);
-            for (const auto& [id, TF] : word_to_document_id_freqs_.at(plus_word)) // итерируем по документам
+            ForEachSegment([&](const auto& segment)
             {
-                document_to_relevance[id] += IDF * TF; // аккумулируем TF * IDF
+                const PostingSpan postings = segment.Find(plus_term.word);
+                if (postings.empty())
+                {
+                    return;
+                }
+                const Posting* posting = postings.begin();
+                for (auto doc_it = std::lower_bound(candidates.begin(), candidates.end(), postings.begin()->doc); doc_it != candidates.end(); ++doc_it)
+                {
+                    posting = SeekPosting(posting, postings.end(), *doc_it);
+                    if (posting == postings.end())
+                    {
+                        break;
+                    }
+                    if (posting->doc == *doc_it)
+                    {
+                        dense.Relevance(*doc_it) += plus_term.weight * posting->tf;
+                    }
+                }
+            });
+            continue;
+        }
+
+        ForEachPosting(plus_term.word, [&](const Posting& posting) // итерируем по документам всех сегментов
+        {
+            if (dense.GetState(posting.doc) == DocumentScratch::UNSEEN && alive_.Test(posting.doc) && PassesPushdown(predicate, posting.doc))
+            {
+                dense.SetState(posting.doc, DocumentScratch::MATCHED);
+                if (prunable)
+                {
+                    candidates.push_back(posting.doc);
+                }
+            }
+            if (dense.GetState(posting.doc) == DocumentScratch::MATCHED)
+            {
+                dense.Relevance(posting.doc) += plus_term.weight * posting.tf; // аккумулируем TF * IDF
+            }
+        });
+
+        if (prunable && candidates.size() >= MAX_RESULT_DOCUMENT_COUNT)
+        {
+            std::pmr::vector<double> scores(resource);
+            scores.reserve(candidates.size());
+            for (const DocIndex doc : candidates)
+            {
+                scores.push_back(dense.Relevance(doc));
+            }
+            std::nth_element(scores.begin(), scores.begin() + MAX_RESULT_DOCUMENT_COUNT - 1, scores.end(), std::greater<>());
+            if (remaining_bound + EPSILON <= scores[MAX_RESULT_DOCUMENT_COUNT - 1])
+            {
+                pruning = true;
+                std::sort(candidates.begin(), candidates.end());
             }
         }
     }
 
-    for (const std::string& minus_word : query_words.minus_words) // тоже самое, что и сверху только теперь удаляем минус-слова
+    const auto collect = [&](DocIndex doc)
+    {
+        for (const PlanTerm& minus_term : plan.checked_terms)
+        {
+            if (ContainsWord(minus_term.word, doc))
+            {
+                return;
+            }
+        }
+        matched_documents.push_back({{index_to_id_[doc], dense.Relevance(doc), ratings_[doc]}, statuses_[doc]});
+    };
+    if (prunable)
+    {
+        for (const DocIndex doc : candidates)
+        {
+            collect(doc);
+        }
+    }
+    else
     {
-        if (word_to_document_id_freqs_.find(minus_word) != word_to_document_id_freqs_.end())
+        for (const DocIndex doc : dense.SortTouched())
         {
-            for (const auto& [id, TF] : word_to_document_id_freqs_.at(minus_word))
+            if (dense.GetState(doc) == DocumentScratch::MATCHED)
             {
-                document_to_relevance.erase(id);
+                collect(doc);
             }
         }
     }
+    return matched_documents;
+}
+
+template <typename T>
+std::pmr::vector<SearchServer::Match> SearchServer::FindAllDocumentsSparse(const Plan& plan, T predicate, std::pmr::memory_resource* resource) const
+{
+    std::pmr::vector<Match> matched_documents(resource);
+    if (plan.unsatisfiable)
+    {
+        return matched_documents;
+    }
 
-    for (const auto& [document_id, relevance] : document_to_relevance)
+    struct Cursor
+    {
+        const Posting* it;
+        const Posting* last;
+        double weight;
+    };
+    // на вершине кучи курсор с наименьшим документом
+    const auto later = [](const Cursor& lhs, const Cursor& rhs)
     {
-        if (predicate(document_id, id_doc_info_.at(document_id).status, id_doc_info_.at(document_id).rating)) // предикат возвращает булево значение
+        return lhs.it->doc > rhs.it->doc;
+    };
+    std::pmr::vector<Cursor> cursors(resource);
+    std::pmr::vector<Cursor> minus_cursors(resource);
+    ForEachSegment([&](const auto& segment)
+    {
+        cursors.clear();
+        for (const PlanTerm& plus_term : plan.plus_terms)
+        {
+            const PostingSpan postings = segment.Find(plus_term.word);
+            if (!postings.empty())
+            {
+                cursors.push_back({postings.begin(), postings.end(), plus_term.weight});
+            }
+        }
+        if (cursors.empty())
         {
-            matched_documents.push_back({document_id, relevance, id_doc_info_.at(document_id).rating});
+            return;
+        }
+        std::make_heap(cursors.begin(), cursors.end(), later);
+
+        minus_cursors.clear();
+        for (const auto* minus_terms : {&plan.excluded_terms, &plan.checked_terms})
+        {
+            for (const PlanTerm& minus_term : *minus_terms)
+            {
+                const PostingSpan postings = segment.Find(minus_term.word);
+                if (!postings.empty())
+                {
+                    minus_cursors.push_back({postings.begin(), postings.end(), 0.0});
+                }
+            }
+        }
+
+        // документы выходят по возрастанию, каждый один раз со всей релевантностью
+        while (!cursors.empty())
+        {
+            const DocIndex doc = cursors.front().it->doc;
+            double relevance = 0.0;
+            while (!cursors.empty() && cursors.front().it->doc == doc)
+            {
+                std::pop_heap(cursors.begin(), cursors.end(), later);
+                Cursor& cursor = cursors.back();
+                relevance += cursor.weight * cursor.it->tf;
+                if (++cursor.it == cursor.last)
+                {
+                    cursors.pop_back();
+                }
+                else
+                {
+                    std::push_heap(cursors.begin(), cursors.end(), later);
+                }
+            }
+
+            bool accepted = alive_.Test(doc) && PassesPushdown(predicate, doc);
+            for (Cursor& minus : minus_cursors) // минус-слова догоняют документ галопом
+            {
+                minus.it = SeekPosting(minus.it, minus.last, doc);
+                accepted = accepted && (minus.it == minus.last || minus.it->doc != doc);
+            }
+            if (accepted)
+            {
+                matched_documents.push_back({{index_to_id_[doc], relevance, ratings_[doc]}, statuses_[doc]});
+            }
+        }
+    });
+    return matched_documents;
+}
+
+template <typename T>
+std::pmr::vector<SearchServer::Match> SearchServer::FindAllDocumentsConjunctive(const Plan& plan, T predicate, std::pmr::memory_resource* resource) const
+{
+    std::pmr::vector<Match> matched_documents(resource);
+    if (plan.unsatisfiable)
+    {
+        return matched_documents;
+    }
+
+    // требование - слово или группа слов (раскрытие префикса, исправления), из которой документу достаточно одного
+    std::pmr::vector<std::pmr::vector<const PlanTerm*>> requirements(plan.requirement_count, resource);
+    for (const PlanTerm& plus_term : plan.plus_terms)
+    {
+        requirements[plus_term.requirement].push_back(&plus_term);
+    }
+    std::pmr::vector<std::string_view> minus_words(resource);
+    for (const auto* minus_terms : {&plan.excluded_terms, &plan.checked_terms})
+    {
+        for (const PlanTerm& minus_term : *minus_terms)
+        {
+            minus_words.push_back(minus_term.word);
         }
     }
+
+    struct Cursor
+    {
+        const Posting* it;
+        const Posting* last;
+        double weight;
+    };
+    // сегменты покрывают непересекающиеся диапазоны документов, поэтому пересекаются по отдельности
+    ForEachSegment([&](const auto& segment)
+    {
+        std::pmr::vector<Cursor> cursors(resource);
+        std::pmr::vector<std::pmr::vector<Posting>> merged_groups(resource);
+        merged_groups.reserve(requirements.size());
+        for (const auto& requirement : requirements)
+        {
+            if (requirement.size() == 1)
+            {
+                const PostingSpan postings = segment.Find(requirement.front()->word);
+                cursors.push_back({postings.begin(), postings.end(), requirement.front()->weight});
+            }
+            else
+            {
+                // группа сливается в один список, TF уже умножен на вес слова
+                std::pmr::vector<Posting>& merged = merged_groups.emplace_back();
+                for (const PlanTerm* plus_term : requirement)
+                {
+                    for (const Posting& posting : segment.Find(plus_term->word))
+                    {
+                        merged.push_back({posting.doc, posting.tf * plus_term->weight});
+                    }
+                }
+                std::sort(merged.begin(), merged.end(), [](const Posting& lhs, const Posting& rhs)
+                {
+                    return lhs.doc < rhs.doc;
+                });
+                size_t unique_count = 0;
+                for (const Posting& posting : merged)
+                {
+                    if (unique_count != 0 && merged[unique_count - 1].doc == posting.doc)
+                    {
+                        merged[unique_count - 1].tf += posting.tf;
+                    }
+                    else
+                    {
+                        merged[unique_count++] = posting;
+                    }
+                }
+                merged.resize(unique_count);
+                cursors.push_back({merged.data(), merged.data() + merged.size(), 1.0});
+            }
+            if (cursors.back().it == cursors.back().last) // в сегменте нет ни одного документа с этим требованием
+            {
+                return;
+            }
+        }
+        std::sort(cursors.begin(), cursors.end(), [](const Cursor& lhs, const Cursor& rhs)
+        {
+            return lhs.last - lhs.it < rhs.last - rhs.it;
+        });
+
+        std::pmr::vector<Cursor> minus_cursors(resource);
+        for (const std::string_view minus_word : minus_words)
+        {
+            const PostingSpan postings = segment.Find(minus_word);
+            if (!postings.empty())
+            {
+                minus_cursors.push_back({postings.begin(), postings.end(), 0.0});
+            }
+        }
+
+        // кандидаты берутся из самого редкого списка, остальные догоняют их галопом
+        Cursor& rarest = cursors.front();
+        while (rarest.it != rarest.last)
+        {
+            const DocIndex candidate = rarest.it->doc;
+            bool in_all = true;
+            for (size_t i = 1; i < cursors.size(); ++i)
+            {
+                cursors[i].it = SeekPosting(cursors[i].it, cursors[i].last, candidate);
+                if (cursors[i].it == cursors[i].last) // один из списков кончился, дальше совпадений нет
+                {
+                    return;
+                }
+                if (cursors[i].it->doc != candidate)
+                {
+                    rarest.it = SeekPosting(rarest.it, rarest.last, cursors[i].it->doc);
+                    in_all = false;
+                    break;
+                }
+            }
+            if (!in_all)
+            {
+                continue;
+            }
+
+            bool accepted = alive_.Test(candidate) && PassesPushdown(predicate, candidate);
+            for (Cursor& minus : minus_cursors) // минус-слова проверяются тем же догоняющим поиском
+            {
+                minus.it = SeekPosting(minus.it, minus.last, candidate);
+                accepted = accepted && (minus.it == minus.last || minus.it->doc != candidate);
+            }
+            if (accepted)
+            {
+                double relevance = 0.0;
+                for (const Cursor& cursor : cursors)
+                {
+                    relevance += cursor.weight * cursor.it->tf;
+                }
+                matched_documents.push_back({{index_to_id_[candidate], relevance, ratings_[candidate]}, statuses_[candidate]});
+            }
+            ++rarest.it;
+        }
+    });
     return matched_documents;
 }
@@ -0,0 +1,108 @@
+// Сервер запросов поверх SearchServer.
+//   search_service --corpus FILE [--stop-words "and with"] [--socket PATH | --port N]
+//                  [--workers N] [--batch N] [--queue N] [--connection-queue N]
+// Сборка: g++ -std=c++17 -O2 -pthread search_service_main.cpp query_service.cpp
+//         corpus_loader.cpp line_reader.cpp search_server.cpp index_segment.cpp deletion_index.cpp query_plan.cpp
+//         query_arena.cpp stop_words.cpp blocked_bloom_filter.cpp string_processing.cpp document.cpp -ltbb
+
+#include <csignal>
+#include <iostream>
+#include <string>
+#include "command_line.h"
+#include "corpus_loader.h"
+#include "query_service.h"
+
+using namespace std;
+
+namespace
+{
+    QueryService* running_service = nullptr;
+
+    void HandleStopSignal(int)
+    {
+        if (running_service != nullptr)
+        {
+            running_service->Stop();
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    string corpus_path;
+    string stop_words;
+    QueryServiceOptions options;
+
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const string flag = argv[i];
+            if (i + 1 >= argc)
+            {
+                throw invalid_argument("No value for "s + flag);
+            }
+            const string value = argv[++i];
+            if (flag == "--corpus"s)
+            {
+                corpus_path = value;
+            }
+            else if (flag == "--stop-words"s)
+            {
+                stop_words = value;
+            }
+            else if (flag == "--socket"s)
+            {
+                options.unix_socket_path = value;
+            }
+            else if (flag == "--port"s)
+            {
+                options.tcp_port = ParsePort(value, flag);
+            }
+            else if (flag == "--workers"s)
+            {
+                options.worker_count = ParseCount(value, flag);
+            }
+            else if (flag == "--batch"s)
+            {
+                options.max_batch_size = ParseCount(value, flag);
+            }
+            else if (flag == "--queue"s)
+            {
+                options.max_pending_requests = ParseCount(value, flag);
+            }
+            else if (flag == "--connection-queue"s)
+            {
+                options.max_connection_requests = ParseCount(value, flag);
+            }
+            else
+            {
+                throw invalid_argument("Unknown option "s + flag);
+            }
+        }
+        if (corpus_path.empty())
+        {
+            throw invalid_argument("--corpus is required"s);
+        }
+
+        SearchServer search_server(stop_words);
+        const size_t document_count = LoadCorpus(search_server, corpus_path);
+        cerr << "Loaded "s << document_count << " documents"s << endl;
+
+        QueryService service(search_server, options);
+        running_service = &service;
+        signal(SIGINT, HandleStopSignal);
+        signal(SIGTERM, HandleStopSignal);
+        signal(SIGPIPE, SIG_IGN);
+
+        cerr << "Listening on "s << (options.unix_socket_path.empty() ? "127.0.0.1:"s + to_string(options.tcp_port) : options.unix_socket_path) << endl;
+        service.Run();
+        running_service = nullptr;
+    }
+    catch (const exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "stop_words.h"
+#include <algorithm>
+#include <numeric>
+#include "memory_stats.h"
+
+using namespace std::literals;
+
+void StopWordSet::Build()
+{
+    const size_t table_mask = slots_.size() - 1;
+    const size_t bucket_mask = seeds_.size() - 1;
+
+    // сортировка подсчётом: слова каждой группы лежат подряд в bucket_words
+    std::vector<uint64_t> hashes(words_.size());
+    std::vector<size_t> bucket_starts(seeds_.size() + 1, 0);
+    for (size_t i = 0; i < words_.size(); ++i)
+    {
+        hashes[i] = HashWord(words_[i]);
+        ++bucket_starts[(hashes[i] & bucket_mask) + 1];
+    }
+    std::partial_sum(bucket_starts.begin(), bucket_starts.end(), bucket_starts.begin());
+    std::vector<uint32_t> bucket_words(words_.size());
+    std::vector<size_t> bucket_ends(bucket_starts.begin(), bucket_starts.end() - 1);
+    for (size_t i = 0; i < words_.size(); ++i)
+    {
+        bucket_words[bucket_ends[hashes[i] & bucket_mask]++] = static_cast<uint32_t>(i);
+    }
+
+    // группы от больших к меньшим, как в BuildPerfectHash
+    std::vector<size_t> buckets(seeds_.size());
+    std::iota(buckets.begin(), buckets.end(), 0);
+    const auto bucket_size = [&bucket_starts](size_t bucket)
+    {
+        return bucket_starts[bucket + 1] - bucket_starts[bucket];
+    };
+    std::sort(buckets.begin(), buckets.end(), [&bucket_size](size_t lhs, size_t rhs)
+    {
+        return bucket_size(lhs) != bucket_size(rhs) ? bucket_size(lhs) > bucket_size(rhs) : lhs < rhs;
+    });
+
+    std::vector<size_t> placed; // слоты, занятые текущей попыткой
+    for (const size_t bucket : buckets)
+    {
+        if (bucket_size(bucket) == 0)
+        {
+            break;
+        }
+        for (uint64_t seed = 1; seeds_[bucket] == 0; ++seed)
+        {
+            if (seed == PERFECT_HASH_MAX_SEED)
+            {
+                throw std::invalid_argument("Cannot build perfect hash for stop words"s);
+            }
+            placed.clear();
+            bool fits = true;
+            for (size_t k = bucket_starts[bucket]; k < bucket_starts[bucket + 1] && fits; ++k)
+            {
+                const uint32_t i = bucket_words[k];
+                const size_t slot = MixHash(hashes[i], seed) & table_mask;
+                if (slots_[slot] == 0)
+                {
+                    slots_[slot] = i + 1;
+                    placed.push_back(slot);
+                }
+                else if (words_[slots_[slot] - 1] != words_[i]) // повтор слова не мешает
+                {
+                    fits = false;
+                }
+            }
+            if (fits)
+            {
+                seeds_[bucket] = seed;
+                continue;
+            }
+            for (const size_t slot : placed)
+            {
+                slots_[slot] = 0;
+            }
+        }
+    }
+}
+
+bool StopWordSet::Contains(std::string_view word) const
+{
+    return PerfectHashContains(words_, slots_, seeds_, word);
+}
+
+size_t StopWordSet::GetMemoryBytes() const
+{
+    size_t bytes = words_.capacity() * sizeof(std::string) + slots_.capacity() * sizeof(uint32_t) + seeds_.capacity() * sizeof(uint64_t);
+    for (const std::string& word : words_)
+    {
+        bytes += HeapBytes(word);
+    }
+    return bytes;
+}
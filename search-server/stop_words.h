@@ -0,0 +1,216 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "word_hash.h"
+
+constexpr size_t PerfectHashTableSize(size_t word_count)
+{
+    size_t size = 1;
+    while (size < 2 * word_count)
+    {
+        size *= 2;
+    }
+    return size;
+}
+
+constexpr size_t PerfectHashBucketCount(size_t word_count)
+{
+    size_t count = 1;
+    while (count < word_count)
+    {
+        count *= 2;
+    }
+    return count;
+}
+
+const uint64_t PERFECT_HASH_MAX_SEED = 1 << 16; // столько затравок перебирается для одной группы
+
+// Совершенное хеширование "хеш и сдвиг": младшие биты хеша делят слова на группы,
+// для каждой группы (от больших к меньшим) подбирается затравка, при которой все её слова
+// попадают в ещё свободные слоты. Слот хранит номер слова + 1, 0 - пустой слот.
+// Эта версия без вспомогательной памяти пересматривает все слова для каждой группы и затравки,
+// то есть квадратична, и нужна только для построения при компиляции; StopWordSet строит
+// ту же таблицу, разложив слова по группам один раз.
+template <typename Words, typename Slots, typename Seeds>
+constexpr void BuildPerfectHash(const Words& words, Slots& slots, Seeds& seeds)
+{
+    const size_t table_mask = slots.size() - 1;
+    const size_t bucket_mask = seeds.size() - 1;
+    const auto bucket_of = [bucket_mask](std::string_view word)
+    {
+        return HashWord(word) & bucket_mask;
+    };
+
+    size_t largest_bucket = 0;
+    for (size_t bucket = 0; bucket < seeds.size(); ++bucket)
+    {
+        size_t bucket_size = 0;
+        for (size_t i = 0; i < words.size(); ++i)
+        {
+            bucket_size += bucket_of(words[i]) == bucket ? 1 : 0;
+        }
+        largest_bucket = bucket_size > largest_bucket ? bucket_size : largest_bucket;
+    }
+
+    for (size_t size = largest_bucket; size > 0; --size)
+    {
+        for (size_t bucket = 0; bucket < seeds.size(); ++bucket)
+        {
+            size_t bucket_size = 0;
+            for (size_t i = 0; i < words.size(); ++i)
+            {
+                bucket_size += bucket_of(words[i]) == bucket ? 1 : 0;
+            }
+            if (bucket_size != size)
+            {
+                continue;
+            }
+
+            for (uint64_t seed = 1; seeds[bucket] == 0; ++seed)
+            {
+                if (seed == PERFECT_HASH_MAX_SEED)
+                {
+                    throw std::invalid_argument("Cannot build perfect hash for stop words");
+                }
+                bool fits = true;
+                for (size_t i = 0; i < words.size() && fits; ++i)
+                {
+                    if (bucket_of(words[i]) != bucket)
+                    {
+                        continue;
+                    }
+                    const size_t slot = MixHash(HashWord(words[i]), seed) & table_mask;
+                    if (slots[slot] == 0)
+                    {
+                        slots[slot] = static_cast<uint32_t>(i + 1);
+                    }
+                    else if (std::string_view(words[slots[slot] - 1]) != std::string_view(words[i])) // повтор слова не мешает
+                    {
+                        fits = false;
+                    }
+                }
+                if (fits)
+                {
+                    seeds[bucket] = seed;
+                    continue;
+                }
+                for (size_t i = 0; i < words.size(); ++i) // откатываем слоты, занятые этой попыткой
+                {
+                    const size_t slot = MixHash(HashWord(words[i]), seed) & table_mask;
+                    if (bucket_of(words[i]) == bucket && slots[slot] == i + 1)
+                    {
+                        slots[slot] = 0;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// один проход по слову и одно сравнение строк
+template <typename Words, typename Slots, typename Seeds>
+constexpr bool PerfectHashContains(const Words& words, const Slots& slots, const Seeds& seeds, std::string_view word)
+{
+    const uint64_t hash = HashWord(word);
+    const uint32_t index = slots[MixHash(hash, seeds[hash & (seeds.size() - 1)]) & (slots.size() - 1)];
+    return index != 0 && std::string_view(words[index - 1]) == word;
+}
+
+// Стоп-слова, известные при компиляции; таблица строится компилятором:
+//   constexpr StaticStopWords<3> STOP_WORDS({"and"sv, "in"sv, "with"sv});
+//   static_assert(STOP_WORDS.Contains("in"sv));
+template <size_t N>
+class StaticStopWords
+{
+public:
+    constexpr explicit StaticStopWords(const std::array<std::string_view, N>& words) : words_(words)
+    {
+        BuildPerfectHash(words_, slots_, seeds_);
+    }
+
+    constexpr bool Contains(std::string_view word) const
+    {
+        return PerfectHashContains(words_, slots_, seeds_, word);
+    }
+
+    constexpr const std::string_view* begin() const
+    {
+        return words_.data();
+    }
+
+    constexpr const std::string_view* end() const
+    {
+        return words_.data() + N;
+    }
+
+    constexpr const std::array<uint32_t, PerfectHashTableSize(N)>& GetSlots() const
+    {
+        return slots_;
+    }
+
+    constexpr const std::array<uint64_t, PerfectHashBucketCount(N)>& GetSeeds() const
+    {
+        return seeds_;
+    }
+
+private:
+    std::array<std::string_view, N> words_;
+    std::array<uint32_t, PerfectHashTableSize(N)> slots_{};
+    std::array<uint64_t, PerfectHashBucketCount(N)> seeds_{};
+};
+
+// Неизменяемый набор стоп-слов с совершенной хеш-таблицей, построенной в конструкторе
+class StopWordSet
+{
+public:
+    // слова должны быть уникальными и непустыми
+    template <typename StringContainer>
+    explicit StopWordSet(const StringContainer& words);
+
+    // таблица берётся готовой, затравки заново не подбираются
+    template <size_t N>
+    explicit StopWordSet(const StaticStopWords<N>& words);
+
+    bool Contains(std::string_view word) const;
+
+    inline std::vector<std::string>::const_iterator begin() const
+    {
+        return words_.begin();
+    }
+
+    inline std::vector<std::string>::const_iterator end() const
+    {
+        return words_.end();
+    }
+
+    size_t GetMemoryBytes() const;
+
+private:
+    void Build();
+
+    std::vector<std::string> words_;
+    std::vector<uint32_t> slots_;
+    std::vector<uint64_t> seeds_;
+};
+
+template <typename StringContainer>
+StopWordSet::StopWordSet(const StringContainer& words)
+    : words_(words.begin(), words.end())
+    , slots_(PerfectHashTableSize(words_.size()), 0)
+    , seeds_(PerfectHashBucketCount(words_.size()), 0)
+{
+    Build();
+}
+
+template <size_t N>
+StopWordSet::StopWordSet(const StaticStopWords<N>& words)
+    : words_(words.begin(), words.end())
+    , slots_(words.GetSlots().begin(), words.GetSlots().end())
+    , seeds_(words.GetSeeds().begin(), words.GetSeeds().end())
+{
+
+}
@@ -26,3 +26,16 @@ std::vector<std::string> SplitIntoWords(const std::string& text)
 
     return words;
 }
+
+std::pmr::vector<std::string_view> SplitIntoWordsView(std::string_view text, std::pmr::memory_resource* resource)
+{
+    std::pmr::vector<std::string_view> words(resource);
+    size_t pos = text.find_first_not_of(' ');
+    while (pos != std::string_view::npos)
+    {
+        const size_t space = text.find(' ', pos);
+        words.push_back(text.substr(pos, space - pos));
+        pos = text.find_first_not_of(' ', space);
+    }
+    return words;
+}
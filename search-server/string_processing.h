@@ -1,19 +1,25 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
+#include <memory_resource>
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 
+// слова ссылаются на text, поэтому text должен жить дольше результата
+std::pmr::vector<std::string_view> SplitIntoWordsView(std::string_view text,
+                                                      std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings)
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings)
 {
-    std::set<std::string> non_empty_strings;
-    for (const std::string& str : strings)
+    std::set<std::string, std::less<>> non_empty_strings;
+    for (const auto& str : strings)
     {
         if (!str.empty())
         {
-            non_empty_strings.insert(str);
+            non_empty_strings.emplace(str);
         }
     }
     return non_empty_strings;
@@ -0,0 +1,1007 @@
+#include "test_search_server.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "blocked_bloom_filter.h"
+#include "deletion_index.h"
+#include "index_segment.h"
+#include "search_server.h"
+#include "stop_words.h"
+
+using namespace std::literals;
+
+namespace
+{
+    const double TEST_EPSILON = 1e-9;
+
+    constexpr StaticStopWords<3> STATIC_STOP_WORDS({"and"sv, "in"sv, "with"sv});
+    static_assert(STATIC_STOP_WORDS.Contains("in"sv) && !STATIC_STOP_WORDS.Contains("on"sv));
+
+    // требование запроса: слова, из которых документу достаточно одного, с множителем веса
+    using Requirement = std::map<std::string, double>;
+
+    struct ReferenceDocument
+    {
+        std::vector<std::string> words; // без стоп-слов
+        DocumentStatus status;
+        int rating;
+    };
+
+    // то, что считал исходный SearchServer: полный перебор документов по TF-IDF
+    class ReferenceIndex
+    {
+    public:
+        void AddDocument(int document_id, const std::vector<std::string>& words, DocumentStatus status, const std::vector<int>& ratings)
+        {
+            int rating = 0;
+            for (const int value : ratings)
+            {
+                rating += value;
+            }
+            documents_[document_id] = {words, status, rating / static_cast<int>(ratings.size())};
+        }
+
+        void RemoveDocument(int document_id)
+        {
+            documents_.erase(document_id);
+        }
+
+        const std::map<int, ReferenceDocument>& GetDocuments() const
+        {
+            return documents_;
+        }
+
+        std::map<std::string, double> GetWordFrequencies(int document_id) const
+        {
+            std::map<std::string, double> word_freqs;
+            const std::vector<std::string>& words = documents_.at(document_id).words;
+            for (const std::string& word : words)
+            {
+                word_freqs[word] += 1.0 / words.size();
+            }
+            return word_freqs;
+        }
+
+        // слова всех документов по алфавиту, как в словаре индекса
+        std::set<std::string> GetVocabulary() const
+        {
+            std::set<std::string> vocabulary;
+            for (const auto& [id, document] : documents_)
+            {
+                vocabulary.insert(document.words.begin(), document.words.end());
+            }
+            return vocabulary;
+        }
+
+        // Релевантность всех подходящих документов со статусом ACTUAL. В режиме ANY документу достаточно
+        // одного слова из любого требования, в режиме ALL - по слову из каждого. Слово, которое входит
+        // в несколько требований, учитывается в релевантности один раз с множителем первого из них.
+        std::map<int, double> Search(const std::vector<Requirement>& requirements, const std::set<std::string>& minus_words,
+                                     MatchMode mode = MatchMode::ANY) const
+        {
+            std::map<std::string, double> weights; // множитель, умноженный на IDF
+            for (const Requirement& requirement : requirements)
+            {
+                for (const auto& [word, weight] : requirement)
+                {
+                    const size_t documents_with_word = CountDocuments(word);
+                    if (documents_with_word != 0)
+                    {
+                        weights.try_emplace(word, std::log(documents_.size() * 1.0 / documents_with_word) * weight);
+                    }
+                }
+            }
+            std::map<int, double> relevance;
+            for (const auto& [id, document] : documents_)
+            {
+                if (document.status != DocumentStatus::ACTUAL
+                    || std::any_of(minus_words.begin(), minus_words.end(), [&document](const std::string& word)
+                {
+                    return Contains(document, word);
+                }))
+                {
+                    continue;
+                }
+                const auto satisfies = [&document](const Requirement& requirement)
+                {
+                    return std::any_of(requirement.begin(), requirement.end(), [&document](const auto& word_weight)
+                    {
+                        return Contains(document, word_weight.first);
+                    });
+                };
+                const bool matched = mode == MatchMode::ALL
+                                   ? !requirements.empty() && std::all_of(requirements.begin(), requirements.end(), satisfies)
+                                   : std::any_of(requirements.begin(), requirements.end(), satisfies);
+                if (!matched)
+                {
+                    continue;
+                }
+                double value = 0.0;
+                for (const auto& [word, weight] : weights)
+                {
+                    if (Contains(document, word))
+                    {
+                        value += GetWordFrequencies(id).at(word) * weight;
+                    }
+                }
+                relevance[id] = value;
+            }
+            return relevance;
+        }
+
+        static bool Contains(const ReferenceDocument& document, const std::string& word)
+        {
+            return std::find(document.words.begin(), document.words.end(), word) != document.words.end();
+        }
+
+    private:
+        size_t CountDocuments(const std::string& word) const
+        {
+            return std::count_if(documents_.begin(), documents_.end(), [&word](const auto& id_document)
+            {
+                return Contains(id_document.second, word);
+            });
+        }
+
+        std::map<int, ReferenceDocument> documents_;
+    };
+
+    // каждое точное плюс-слово - отдельное требование
+    std::vector<Requirement> Exact(const std::set<std::string>& plus_words)
+    {
+        std::vector<Requirement> requirements;
+        for (const std::string& word : plus_words)
+        {
+            requirements.push_back({{word, 1.0}});
+        }
+        return requirements;
+    }
+
+    // первые limit слов словаря с префиксом, как их раскрывает индекс
+    Requirement Expand(const std::set<std::string>& vocabulary, const std::string& prefix, size_t limit)
+    {
+        Requirement requirement;
+        for (auto word_it = vocabulary.lower_bound(prefix);
+             word_it != vocabulary.end() && requirement.size() < limit && word_it->compare(0, prefix.size(), prefix) == 0; ++word_it)
+        {
+            requirement.emplace(*word_it, 1.0);
+        }
+        return requirement;
+    }
+
+    std::string RandomWord(std::mt19937& generator)
+    {
+        // треть слов частые, чтобы у запросов были длинные списки и включалась стратегия PRUNED
+        return generator() % 3 == 0 ? "common"s + std::to_string(generator() % 3) : "w"s + std::to_string(generator() % 400);
+    }
+
+    void CheckTopDocuments(const std::vector<Document>& found, const std::map<int, double>& relevance, const ReferenceIndex& reference)
+    {
+        std::vector<Document> expected;
+        for (const auto& [id, value] : relevance)
+        {
+            expected.push_back({id, value, reference.GetDocuments().at(id).rating});
+        }
+        std::sort(expected.begin(), expected.end(), [](const Document& lhs, const Document& rhs)
+        {
+            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON)
+            {
+                return lhs.rating > rhs.rating;
+            }
+            return lhs.relevance > rhs.relevance;
+        });
+        assert(found.size() == std::min<size_t>(expected.size(), MAX_RESULT_DOCUMENT_COUNT));
+        for (size_t i = 0; i < found.size(); ++i)
+        {
+            // при равной релевантности порядок документов может отличаться, поэтому сверяем значения по позициям
+            assert(std::abs(found[i].relevance - expected[i].relevance) < TEST_EPSILON);
+            assert(std::abs(found[i].relevance - relevance.at(found[i].id)) < TEST_EPSILON);
+            assert(found[i].rating == reference.GetDocuments().at(found[i].id).rating);
+        }
+    }
+
+    void CheckWordFrequencies(const SearchServer& search_server, int document_id, const ReferenceIndex& reference)
+    {
+        const std::map<std::string, double> expected = reference.GetWordFrequencies(document_id);
+        const SearchServer::WordFrequencies& word_freqs = search_server.GetWordFrequencies(document_id);
+        assert(word_freqs.size() == expected.size());
+        for (const auto& [word, freq] : expected)
+        {
+            const auto freq_it = word_freqs.find(std::string_view(word));
+            assert(freq_it != word_freqs.end() && std::abs(freq_it->second - freq) < TEST_EPSILON);
+        }
+    }
+
+    // случайные запросы к обоим режимам индекса; считает, сколько раз выбрана каждая стратегия
+    void CheckQueries(const SearchServer& full, const SearchServer& compact, const ReferenceIndex& reference, std::mt19937& generator,
+                      std::map<QueryStrategy, size_t>& strategies)
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            std::string query;
+            std::set<std::string> plus_words;
+            std::set<std::string> minus_words;
+            for (size_t count = 1 + generator() % 3; count > 0; --count)
+            {
+                plus_words.insert(RandomWord(generator));
+            }
+            if (generator() % 3 == 0)
+            {
+                minus_words.insert(RandomWord(generator));
+            }
+            for (const std::string& word : plus_words)
+            {
+                query += word + " "s;
+            }
+            for (const std::string& word : minus_words)
+            {
+                query += "-"s + word + " "s;
+            }
+            query += generator() % 2 == 0 ? "and absent"s : "with"s; // стоп-слово и слово, которого нет в словаре
+
+            const std::map<int, double> relevance = reference.Search(Exact(plus_words), minus_words);
+            const std::vector<Document> found = full.FindTopDocuments(query);
+            CheckTopDocuments(found, relevance, reference);
+            CheckTopDocuments(compact.FindTopDocuments(query), relevance, reference);
+
+            // с произвольным предикатом статус не опускается в индекс и отсечение не применяется
+            const std::vector<Document> exhaustive = full.FindTopDocuments(query, [](int, DocumentStatus status, int)
+            {
+                return status == DocumentStatus::ACTUAL;
+            });
+            ++strategies[full.Explain(query).strategy];
+            assert(exhaustive.size() == found.size());
+            for (size_t j = 0; j < found.size(); ++j)
+            {
+                assert(std::abs(exhaustive[j].relevance - found[j].relevance) < TEST_EPSILON);
+                assert(exhaustive[j].rating == found[j].rating);
+            }
+
+            auto document_it = reference.GetDocuments().begin();
+            std::advance(document_it, generator() % reference.GetDocuments().size());
+            const auto& [document_id, document] = *document_it;
+            std::vector<std::string> expected_words;
+            if (std::none_of(minus_words.begin(), minus_words.end(), [&document](const std::string& word)
+            {
+                return std::count(document.words.begin(), document.words.end(), word) > 0;
+            }))
+            {
+                std::copy_if(plus_words.begin(), plus_words.end(), std::back_inserter(expected_words), [&document](const std::string& word)
+                {
+                    return std::count(document.words.begin(), document.words.end(), word) > 0;
+                });
+            }
+            for (const SearchServer* search_server : {&full, &compact})
+            {
+                const auto [matched_words, status] = search_server->MatchDocument(query, document_id);
+                assert(matched_words == expected_words && status == document.status);
+            }
+        }
+    }
+
+    void TestAgainstReference()
+    {
+        SearchServer full("and with"s);
+        SearchServer compact("and with"s, IndexMode::COMPACT);
+        ReferenceIndex reference;
+        std::mt19937 generator(42);
+
+        // больше нескольких SEGMENT_FLUSH_DOCUMENTS, чтобы сегменты замораживались и сливались
+        const int document_count = static_cast<int>(3 * SEGMENT_FLUSH_DOCUMENTS);
+        std::map<QueryStrategy, size_t> strategies;
+        for (int id = 0; id < document_count; ++id)
+        {
+            std::string text;
+            std::vector<std::string> words;
+            for (size_t count = 3 + generator() % 10; count > 0; --count)
+            {
+                words.push_back(RandomWord(generator));
+                text += words.back() + (generator() % 4 == 0 ? " and "s : " "s);
+            }
+            const DocumentStatus status = generator() % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            const std::vector<int> ratings = {static_cast<int>(generator() % 100) - 50, static_cast<int>(generator() % 10)};
+            full.AddDocument(id, text, status, ratings);
+            compact.AddDocument(id, text, status, ratings);
+            reference.AddDocument(id, words, status, ratings);
+            if (id % 700 == 699)
+            {
+                CheckQueries(full, compact, reference, generator, strategies);
+            }
+        }
+
+        // удалённых становится больше живых, и индекс компактизируется
+        std::vector<int> ids(document_count);
+        for (int id = 0; id < document_count; ++id)
+        {
+            ids[id] = id;
+        }
+        std::shuffle(ids.begin(), ids.end(), generator);
+        const SearchServer::WordFrequencies& kept_word_freqs = full.GetWordFrequencies(ids.back());
+        for (int i = 0; i < document_count * 2 / 3; ++i)
+        {
+            full.RemoveDocument(ids[i]);
+            compact.RemoveDocument(ids[i]);
+            reference.RemoveDocument(ids[i]);
+            if (i % 500 == 499)
+            {
+                CheckQueries(full, compact, reference, generator, strategies);
+            }
+        }
+        CheckQueries(full, compact, reference, generator, strategies);
+        assert(strategies[QueryStrategy::PRUNED] > 0 && strategies[QueryStrategy::SPARSE] > 0);
+
+        assert(full.GetDocumentCount() == static_cast<int>(reference.GetDocuments().size()));
+        assert(compact.GetDocumentCount() == full.GetDocumentCount());
+        assert(&kept_word_freqs == &full.GetWordFrequencies(ids.back())); // ссылка пережила добавления и компактизацию
+        for (const auto& [id, document] : reference.GetDocuments())
+        {
+            CheckWordFrequencies(full, id, reference);
+            CheckWordFrequencies(compact, id, reference);
+        }
+        assert(full.GetWordFrequencies(ids.front()).empty());
+    }
+
+    // слова документа из запроса с точными словами и префиксами, как их вернёт MatchDocument
+    std::vector<std::string> ExpectedMatch(const ReferenceDocument& document, const std::vector<Requirement>& requirements,
+                                           const std::set<std::string>& minus_words)
+    {
+        std::set<std::string> matched_words;
+        for (const Requirement& requirement : requirements)
+        {
+            for (const auto& [word, weight] : requirement)
+            {
+                if (ReferenceIndex::Contains(document, word))
+                {
+                    matched_words.insert(word);
+                }
+            }
+        }
+        if (std::any_of(minus_words.begin(), minus_words.end(), [&document](const std::string& word)
+        {
+            return ReferenceIndex::Contains(document, word);
+        }))
+        {
+            matched_words.clear();
+        }
+        return {matched_words.begin(), matched_words.end()};
+    }
+
+    void TestPrefixQueries()
+    {
+        SearchServer full("and with"s);
+        SearchServer compact("and with"s, IndexMode::COMPACT);
+        ReferenceIndex reference;
+        std::mt19937 generator(7);
+
+        // у "pet" слов больше MAX_PREFIX_EXPANSIONS, так что раскрытие обрезается
+        const auto random_word = [&generator]()
+        {
+            switch (generator() % 4)
+            {
+            case 0:
+                return "cat"s + std::to_string(generator() % 20);
+            case 1:
+                return "car"s + std::to_string(generator() % 20);
+            default:
+                return "pet"s + std::to_string(generator() % 150);
+            }
+        };
+        for (int id = 0; id < 1500; ++id)
+        {
+            std::string text;
+            std::vector<std::string> words;
+            for (size_t count = 2 + generator() % 6; count > 0; --count)
+            {
+                words.push_back(random_word());
+                text += words.back() + " "s;
+            }
+            const DocumentStatus status = generator() % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            full.AddDocument(id, text, status, {id % 7});
+            compact.AddDocument(id, text, status, {id % 7});
+            reference.AddDocument(id, words, status, {id % 7});
+        }
+        for (int id = 0; id < 1500; id += 3)
+        {
+            full.RemoveDocument(id);
+            compact.RemoveDocument(id);
+            reference.RemoveDocument(id);
+        }
+        const std::set<std::string> vocabulary = reference.GetVocabulary();
+
+        const std::vector<std::string> prefixes = {"pet"s, "pet1"s, "pet12"s, "ca"s, "car1"s, "cat19"s, "zz"s};
+        for (int i = 0; i < 300; ++i)
+        {
+            std::set<std::string> plus_words;
+            std::set<std::string> plus_prefixes;
+            std::set<std::string> minus_words;
+            std::string query;
+            for (size_t count = generator() % 3; count > 0; --count)
+            {
+                plus_words.insert(random_word());
+            }
+            for (size_t count = 1 + generator() % 2; count > 0; --count)
+            {
+                plus_prefixes.insert(prefixes[generator() % prefixes.size()]);
+            }
+            if (generator() % 3 == 0)
+            {
+                const std::string minus_prefix = prefixes[generator() % prefixes.size()];
+                const Requirement expansions = Expand(vocabulary, minus_prefix, vocabulary.size()); // минус-префикс не обрезается
+                for (const auto& [word, weight] : expansions)
+                {
+                    minus_words.insert(word);
+                }
+                query += "-"s + minus_prefix + "* "s;
+            }
+            if (generator() % 3 == 0)
+            {
+                const std::string minus_word = random_word();
+                minus_words.insert(minus_word);
+                query += "-"s + minus_word + " "s;
+            }
+
+            // точные слова раньше раскрытий, поэтому слово из обоих учитывается один раз
+            std::vector<Requirement> requirements = Exact(plus_words);
+            for (const std::string& prefix : plus_prefixes)
+            {
+                requirements.push_back(Expand(vocabulary, prefix, MAX_PREFIX_EXPANSIONS));
+                query += prefix + "* "s;
+            }
+            for (const std::string& word : plus_words)
+            {
+                query += word + " "s;
+            }
+
+            const std::map<int, double> relevance = reference.Search(requirements, minus_words);
+            CheckTopDocuments(full.FindTopDocuments(query), relevance, reference);
+            CheckTopDocuments(compact.FindTopDocuments(query), relevance, reference);
+
+            auto document_it = reference.GetDocuments().begin();
+            std::advance(document_it, generator() % reference.GetDocuments().size());
+            const std::vector<std::string> expected_words = ExpectedMatch(document_it->second, requirements, minus_words);
+            for (const SearchServer* search_server : {&full, &compact})
+            {
+                const auto [matched_words, status] = search_server->MatchDocument(query, document_it->first);
+                assert(matched_words == expected_words && status == document_it->second.status);
+            }
+        }
+
+        assert(full.Explain("pet*"s).plus_terms.size() == MAX_PREFIX_EXPANSIONS);
+        const QueryPlan minus_plan = full.Explain("cat1 -pet*"s);
+        assert(minus_plan.excluded_terms.size() + minus_plan.checked_terms.size() == Expand(vocabulary, "pet"s, vocabulary.size()).size());
+        assert(full.Explain("zz* cat1"s).dropped_words == std::vector<std::string>{"zz*"s});
+        try
+        {
+            full.FindTopDocuments("cat1 -*"s);
+            assert(false);
+        }
+        catch (const std::invalid_argument&)
+        {
+        }
+    }
+
+    // расстояние с перестановкой соседних символов полной таблицей, без отсечения по пределу
+    size_t ReferenceEditDistance(const std::string& lhs, const std::string& rhs)
+    {
+        std::vector<std::vector<size_t>> distance(lhs.size() + 1, std::vector<size_t>(rhs.size() + 1, 0));
+        for (size_t i = 0; i <= lhs.size(); ++i)
+        {
+            for (size_t j = 0; j <= rhs.size(); ++j)
+            {
+                if (i == 0 || j == 0)
+                {
+                    distance[i][j] = i + j;
+                    continue;
+                }
+                distance[i][j] = std::min({distance[i - 1][j] + 1, distance[i][j - 1] + 1,
+                                           distance[i - 1][j - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1)});
+                if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1])
+                {
+                    distance[i][j] = std::min(distance[i][j], distance[i - 2][j - 2] + 1);
+                }
+            }
+        }
+        return distance[lhs.size()][rhs.size()];
+    }
+
+    // исправления, которые должен найти индекс: слова словаря на наименьшем расстоянии от 1 до max_distance
+    std::map<std::string, size_t> ReferenceCorrections(const std::string& word, const std::set<std::string>& vocabulary, size_t max_distance)
+    {
+        std::map<std::string, size_t> corrections;
+        size_t best = max_distance + 1;
+        for (const std::string& term : vocabulary)
+        {
+            const size_t distance = ReferenceEditDistance(word, term);
+            if (distance != 0 && distance <= max_distance && distance <= best)
+            {
+                if (distance < best)
+                {
+                    corrections.clear();
+                    best = distance;
+                }
+                corrections[term] = distance;
+            }
+        }
+        return corrections;
+    }
+
+    std::string RandomLetters(std::mt19937& generator, size_t min_length, size_t max_length)
+    {
+        std::string word(min_length + generator() % (max_length - min_length + 1), 'a');
+        for (char& letter : word)
+        {
+            letter = static_cast<char>('a' + generator() % 5);
+        }
+        return word;
+    }
+
+    // одна или две правки в случайных местах, в том числе за префиксом DELETION_PREFIX_LENGTH
+    std::string Misspell(std::string word, std::mt19937& generator)
+    {
+        for (size_t edits = 1 + generator() % 2; edits > 0 && word.size() > 1; --edits)
+        {
+            const size_t position = generator() % word.size();
+            switch (generator() % 4)
+            {
+            case 0:
+                word[position] = static_cast<char>('a' + generator() % 5);
+                break;
+            case 1:
+                word.insert(position, 1, static_cast<char>('a' + generator() % 5));
+                break;
+            case 2:
+                word.erase(position, 1);
+                break;
+            default:
+                if (position + 1 < word.size())
+                {
+                    std::swap(word[position], word[position + 1]);
+                }
+            }
+        }
+        return word;
+    }
+
+    void TestEditDistance()
+    {
+        std::mt19937 generator(3);
+        for (int i = 0; i < 5000; ++i)
+        {
+            const std::string lhs = RandomLetters(generator, 0, 7);
+            const std::string rhs = generator() % 2 == 0 ? Misspell(lhs, generator) : RandomLetters(generator, 0, 7);
+            const size_t distance = ReferenceEditDistance(lhs, rhs);
+            for (size_t limit = 0; limit <= 3; ++limit)
+            {
+                assert(EditDistance(lhs, rhs, limit) == std::min(distance, limit + 1));
+            }
+        }
+        assert(EditDistance("ab"sv, "ba"sv, 2) == 1);
+        assert(EditDistance("ca"sv, "abc"sv, 3) == 3); // перестановка не совмещается с другими правками того же места
+    }
+
+    void TestDeletionIndex()
+    {
+        std::mt19937 generator(5);
+        for (size_t max_distance = 1; max_distance <= MAX_FUZZY_DISTANCE; ++max_distance)
+        {
+            DeletionIndex index(max_distance, std::pmr::get_default_resource());
+            std::set<std::string> vocabulary;
+            while (vocabulary.size() < 400)
+            {
+                const std::string term = RandomLetters(generator, 2, 12);
+                if (vocabulary.insert(term).second)
+                {
+                    index.AddTerm(term);
+                }
+            }
+            for (auto term_it = vocabulary.begin(); term_it != vocabulary.end(); )
+            {
+                if (generator() % 4 == 0)
+                {
+                    index.RemoveTerm(*term_it);
+                    term_it = vocabulary.erase(term_it);
+                }
+                else
+                {
+                    ++term_it;
+                }
+            }
+
+            // правки за пределами префикса находятся по общему префиксу
+            index.AddTerm("abcdeabcdeab"sv);
+            vocabulary.insert("abcdeabcdeab"s);
+            for (const std::string_view word : {"abcdeabcdeaa"sv, "abcdeabcdeabb"sv, "abcdeabcdea"sv, "abcdeabcdeba"sv, "bacdeabcdeab"sv})
+            {
+                bool found = false;
+                std::pmr::monotonic_buffer_resource scratch;
+                index.ForEachCorrection(word, &scratch, [&found](std::string_view term, size_t distance)
+                {
+                    found = found || (term == "abcdeabcdeab"sv && distance == 1);
+                });
+                assert(found);
+            }
+
+            for (int i = 0; i < 500; ++i)
+            {
+                auto term_it = vocabulary.begin();
+                std::advance(term_it, generator() % vocabulary.size());
+                const std::string word = generator() % 4 == 0 ? RandomLetters(generator, 1, 13) : Misspell(*term_it, generator);
+                std::map<std::string, size_t> found;
+                std::pmr::monotonic_buffer_resource scratch;
+                index.ForEachCorrection(word, &scratch, [&found](std::string_view term, size_t distance)
+                {
+                    assert(found.emplace(std::string(term), distance).second);
+                });
+                assert(found == ReferenceCorrections(word, vocabulary, max_distance));
+            }
+        }
+    }
+
+    void TestFuzzyQueries()
+    {
+        SearchServer full("and with"s);
+        SearchServer compact("and with"s, IndexMode::COMPACT);
+        ReferenceIndex reference;
+        std::mt19937 generator(9);
+
+        std::vector<std::string> words;
+        for (int i = 0; i < 150; ++i)
+        {
+            words.push_back(RandomLetters(generator, 3, 11));
+        }
+        for (int id = 0; id < 1200; ++id)
+        {
+            std::string text;
+            std::vector<std::string> document_words;
+            for (size_t count = 2 + generator() % 6; count > 0; --count)
+            {
+                document_words.push_back(words[generator() % words.size()]);
+                text += document_words.back() + " "s;
+            }
+            const DocumentStatus status = generator() % 5 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+            full.AddDocument(id, text, status, {id % 11});
+            compact.AddDocument(id, text, status, {id % 11});
+            reference.AddDocument(id, document_words, status, {id % 11});
+        }
+
+        const double correction_weight = 0.5;
+        const auto check_queries = [&](size_t max_distance)
+        {
+            const std::set<std::string> vocabulary = reference.GetVocabulary();
+            for (int i = 0; i < 200; ++i)
+            {
+                std::set<std::string> plus_words;
+                for (size_t count = 1 + generator() % 2; count > 0; --count)
+                {
+                    const std::string& word = words[generator() % words.size()];
+                    plus_words.insert(generator() % 3 == 0 ? word : Misspell(word, generator));
+                }
+                std::set<std::string> minus_words;
+                if (generator() % 4 == 0)
+                {
+                    minus_words.insert(words[generator() % words.size()]);
+                }
+
+                // слова словаря идут раньше исправлений, исправления - в порядке слов запроса
+                std::vector<Requirement> requirements;
+                std::string query;
+                for (const std::string& word : plus_words)
+                {
+                    query += word + " "s;
+                    if (vocabulary.count(word) != 0)
+                    {
+                        requirements.push_back({{word, 1.0}});
+                    }
+                }
+                for (const std::string& word : plus_words)
+                {
+                    if (vocabulary.count(word) != 0 || max_distance == 0)
+                    {
+                        continue;
+                    }
+                    Requirement corrections;
+                    for (const auto& [term, distance] : ReferenceCorrections(word, vocabulary, max_distance))
+                    {
+                        corrections.emplace(term, std::pow(correction_weight, distance));
+                    }
+                    if (!corrections.empty())
+                    {
+                        requirements.push_back(corrections);
+                    }
+                }
+                for (const std::string& word : minus_words)
+                {
+                    query += "-"s + word + " "s;
+                }
+
+                const std::map<int, double> relevance = reference.Search(requirements, minus_words);
+                CheckTopDocuments(full.FindTopDocuments(query), relevance, reference);
+                CheckTopDocuments(compact.FindTopDocuments(query), relevance, reference);
+
+                auto document_it = reference.GetDocuments().begin();
+                std::advance(document_it, generator() % reference.GetDocuments().size());
+                const std::vector<std::string> expected_words = ExpectedMatch(document_it->second, requirements, minus_words);
+                for (const SearchServer* search_server : {&full, &compact})
+                {
+                    assert(std::get<0>(search_server->MatchDocument(query, document_it->first)) == expected_words);
+                }
+            }
+        };
+
+        for (SearchServer* search_server : {&full, &compact})
+        {
+            search_server->SetFuzzyMatching(MAX_FUZZY_DISTANCE, correction_weight);
+        }
+        check_queries(MAX_FUZZY_DISTANCE);
+
+        // удалённые слова уходят и из индекса удалений
+        for (int id = 0; id < 1200; id += 2)
+        {
+            full.RemoveDocument(id);
+            compact.RemoveDocument(id);
+            reference.RemoveDocument(id);
+        }
+        check_queries(MAX_FUZZY_DISTANCE);
+
+        for (SearchServer* search_server : {&full, &compact})
+        {
+            search_server->SetFuzzyMatching(1, correction_weight);
+        }
+        check_queries(1);
+        for (SearchServer* search_server : {&full, &compact})
+        {
+            search_server->SetFuzzyMatching(0);
+        }
+        check_queries(0);
+
+        for (const auto& [max_distance, weight] : {std::pair{MAX_FUZZY_DISTANCE + 1, 0.5}, std::pair{size_t{1}, 0.0}, std::pair{size_t{1}, 1.5}})
+        {
+            try
+            {
+                full.SetFuzzyMatching(max_distance, weight);
+                assert(false);
+            }
+            catch (const std::invalid_argument&)
+            {
+            }
+        }
+    }
+
+    void TestMatchAll()
+    {
+        SearchServer full("and with"s);
+        SearchServer compact("and with"s, IndexMode::COMPACT);
+        ReferenceIndex reference;
+        std::mt19937 generator(11);
+
+        const auto random_word = [&generator]()
+        {
+            switch (generator() % 3)
+            {
+            case 0:
+                return "cat"s + std::to_string(generator() % 10);
+            case 1:
+                return "car"s + std::to_string(generator() % 10);
+            default:
+                return "pet"s + std::to_string(generator() % 100);
+            }
+        };
+        for (int id = 0; id < 2000; ++id)
+        {
+            std::string text;
+            std::vector<std::string> words;
+            for (size_t count = 3 + generator() % 7; count > 0; --count)
+            {
+                words.push_back(random_word());
+                text += words.back() + " "s;
+            }
+            const DocumentStatus status = generator() % 5 == 0 ? DocumentStatus::REMOVED : DocumentStatus::ACTUAL;
+            full.AddDocument(id, text, status, {id % 13});
+            compact.AddDocument(id, text, status, {id % 13});
+            reference.AddDocument(id, words, status, {id % 13});
+        }
+        for (int id = 1; id < 2000; id += 4)
+        {
+            full.RemoveDocument(id);
+            compact.RemoveDocument(id);
+            reference.RemoveDocument(id);
+        }
+        const double correction_weight = 0.5;
+        for (SearchServer* search_server : {&full, &compact})
+        {
+            search_server->SetFuzzyMatching(1, correction_weight);
+        }
+        const std::set<std::string> vocabulary = reference.GetVocabulary();
+
+        // "pet" раскрывается с обрезкой, "pet1" пересекается с ним и с точными словами
+        const std::vector<std::string> prefixes = {"pet"s, "pet1"s, "pet12"s, "ca"s, "car1"s, "cat9"s, "zz"s};
+        size_t nonempty_results = 0;
+        for (int i = 0; i < 400; ++i)
+        {
+            std::set<std::string> plus_words;
+            std::set<std::string> plus_prefixes;
+            std::set<std::string> minus_words;
+            std::string query;
+            for (size_t count = generator() % 3; count > 0; --count)
+            {
+                // опечатка "x" в конце даёт группу исправлений, например "pet1x" - "pet1", "pet10".."pet19"
+                plus_words.insert(generator() % 4 == 0 ? random_word() + "x"s : random_word());
+            }
+            for (size_t count = plus_words.empty() ? 1 + generator() % 2 : generator() % 2; count > 0; --count)
+            {
+                plus_prefixes.insert(prefixes[generator() % prefixes.size()]);
+            }
+            if (generator() % 3 == 0)
+            {
+                const std::string minus_word = random_word();
+                minus_words.insert(minus_word);
+                query += "-"s + minus_word + " "s;
+            }
+
+            // требования в порядке планировщика: точные слова, префиксы, исправления
+            std::vector<Requirement> requirements;
+            bool satisfiable = true;
+            for (const std::string& word : plus_words)
+            {
+                query += word + " "s;
+                if (vocabulary.count(word) != 0)
+                {
+                    requirements.push_back({{word, 1.0}});
+                }
+            }
+            for (const std::string& prefix : plus_prefixes)
+            {
+                query += prefix + "* "s;
+                const Requirement expansions = Expand(vocabulary, prefix, MAX_PREFIX_EXPANSIONS);
+                satisfiable = satisfiable && !expansions.empty();
+                requirements.push_back(expansions);
+            }
+            for (const std::string& word : plus_words)
+            {
+                if (vocabulary.count(word) != 0)
+                {
+                    continue;
+                }
+                Requirement corrections;
+                for (const auto& [term, distance] : ReferenceCorrections(word, vocabulary, 1))
+                {
+                    corrections.emplace(term, std::pow(correction_weight, distance));
+                }
+                satisfiable = satisfiable && !corrections.empty();
+                requirements.push_back(corrections);
+            }
+
+            // пропущенное слово или префикс делает запрос ALL невыполнимым
+            const std::map<int, double> relevance = satisfiable ? reference.Search(requirements, minus_words, MatchMode::ALL)
+                                                                : std::map<int, double>{};
+            nonempty_results += relevance.empty() ? 0 : 1;
+            CheckTopDocuments(full.FindTopDocuments(MatchMode::ALL, query), relevance, reference);
+            CheckTopDocuments(compact.FindTopDocuments(MatchMode::ALL, query), relevance, reference);
+            assert(full.Explain(MatchMode::ALL, query).strategy == QueryStrategy::CONJUNCTIVE);
+        }
+        assert(nonempty_results > 100);
+
+        // повтор слова остаётся в каждом требовании, но вес получает только первое вхождение
+        const QueryPlan plan = full.Explain(MatchMode::ALL, "pet1 pet1*"s);
+        const auto repeated = std::count_if(plan.plus_terms.begin(), plan.plus_terms.end(), [](const PlannedTerm& term)
+        {
+            return term.word == "pet1"s;
+        });
+        const auto weighted = std::count_if(plan.plus_terms.begin(), plan.plus_terms.end(), [](const PlannedTerm& term)
+        {
+            return term.word == "pet1"s && term.weight > 0.0;
+        });
+        assert(repeated == 2 && weighted == 1);
+        assert(full.FindTopDocuments(MatchMode::ALL, "pet1 zzzz"s).empty());
+        assert(full.FindTopDocuments(MatchMode::ALL, "pet1 zz*"s).empty());
+    }
+
+    void TestSeekPosting()
+    {
+        // размеры вокруг границы блока и шагов галопа
+        for (const size_t size : {0, 1, 7, 8, 9, 15, 16, 17, 23, 24, 25, 40, 100, 257})
+        {
+            std::vector<Posting> postings;
+            for (size_t i = 0; i < size; ++i)
+            {
+                postings.push_back({static_cast<DocIndex>(2 * i + 1), 1.0});
+            }
+            const Posting* first = postings.data();
+            const Posting* last = postings.data() + size;
+            for (size_t from = 0; from <= size; ++from)
+            {
+                for (DocIndex target = 0; target <= 2 * size + 2; ++target)
+                {
+                    const Posting* expected = std::lower_bound(first + from, last, target, [](const Posting& posting, DocIndex doc)
+                    {
+                        return posting.doc < doc;
+                    });
+                    assert(SeekPosting(first + from, last, target) == expected);
+                }
+            }
+        }
+    }
+
+    void TestStopWords()
+    {
+        std::vector<std::string> words;
+        for (int i = 0; i < 1000; ++i)
+        {
+            words.push_back("stop"s + std::to_string(i));
+        }
+        const StopWordSet stop_words(words);
+        for (int i = 0; i < 2000; ++i)
+        {
+            assert(stop_words.Contains("stop"s + std::to_string(i)) == (i < 1000));
+        }
+        assert(!stop_words.Contains(""sv));
+
+        SearchServer search_server(STATIC_STOP_WORDS);
+        search_server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(2, "dog with collar"s, DocumentStatus::ACTUAL, {2});
+        assert(search_server.FindTopDocuments("in with"s).empty());
+        assert(search_server.FindTopDocuments("cat with"s).size() == 1);
+        assert(search_server.GetWordFrequencies(2).size() == 2);
+    }
+
+    void TestTermFilter()
+    {
+        BlockedBloomFilter filter(1000);
+        for (int i = 0; i < 1000; ++i)
+        {
+            filter.Add("term"s + std::to_string(i));
+        }
+        size_t false_positives = 0;
+        for (int i = 0; i < 1000; ++i)
+        {
+            assert(filter.MayContain("term"s + std::to_string(i)));
+            false_positives += filter.MayContain("other"s + std::to_string(i)) ? 1 : 0;
+        }
+        assert(false_positives < 20);
+    }
+
+    void TestNestedQuery()
+    {
+        SearchServer search_server("and"s);
+        for (int id = 0; id < 100; ++id)
+        {
+            search_server.AddDocument(id, "cat w"s + std::to_string(id % 10), DocumentStatus::ACTUAL, {id});
+        }
+        const std::vector<Document> expected = search_server.FindTopDocuments("cat -w3"s, [](int document_id, DocumentStatus, int)
+        {
+            return document_id % 2 == 0;
+        });
+        // предикат сам ищет в том же сервере: арена внешнего запроса и блокировка не должны пострадать
+        const std::vector<Document> found = search_server.FindTopDocuments("cat -w3"s, [&search_server](int document_id, DocumentStatus, int)
+        {
+            return !search_server.FindTopDocuments("w"s + std::to_string(document_id % 10) + " cat"s).empty() && document_id % 2 == 0;
+        });
+        assert(found.size() == expected.size());
+        for (size_t i = 0; i < found.size(); ++i)
+        {
+            assert(found[i].id == expected[i].id && std::abs(found[i].relevance - expected[i].relevance) < TEST_EPSILON);
+        }
+    }
+}
+
+void TestSearchServer()
+{
+    TestSeekPosting();
+    TestStopWords();
+    TestTermFilter();
+    TestNestedQuery();
+    TestAgainstReference();
+    TestPrefixQueries();
+    TestEditDistance();
+    TestDeletionIndex();
+    TestFuzzyQueries();
+    TestMatchAll();
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Сверяет индекс с простой эталонной моделью TF-IDF на случайном корпусе:
+// сегменты и слияния, удаление с компактизацией, режимы FULL и COMPACT,
+// стратегии PRUNED, SPARSE и EXHAUSTIVE, SeekPosting, стоп-слова, фильтр Блума,
+// поиск из предиката другого поиска, префиксные запросы, исправление опечаток
+// (EditDistance, DeletionIndex с усечением до DELETION_PREFIX_LENGTH, SetFuzzyMatching)
+// и режим MatchMode::ALL с группами раскрытий и исправлений.
+// При расхождении срабатывает assert.
+void TestSearchServer();
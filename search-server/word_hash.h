@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// FNV-1a; constexpr, чтобы таблицы для известных при компиляции слов строились компилятором
+constexpr uint64_t HashWord(std::string_view word)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : word)
+    {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// перемешивает готовый хеш с затравкой: из одного прохода по слову получается семейство хешей
+constexpr uint64_t MixHash(uint64_t hash, uint64_t seed)
+{
+    hash ^= seed * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}